@@ -0,0 +1,333 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "proto.hpp"
+#include "includes/BytecodeCache.hpp"
+
+#define EXIT_UNEXPECTED_ARGS 2
+#define EXIT_BENCH_FAILED 1
+
+//! Every allocation the interpreter makes goes through these, so a run's count is the
+//! difference between the counters before and after it
+static std::size_t allocations = 0;
+static std::size_t allocatedBytes = 0;
+
+//! Kept out of line, GCC otherwise sees free() called on what operator new returned
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+static void* allocate(std::size_t size) {
+	allocations++;
+	allocatedBytes += size;
+	return std::malloc(size ? size : 1);
+}
+
+static void* allocate(std::size_t size, std::align_val_t align) {
+	allocations++;
+	allocatedBytes += size;
+	//! aligned_alloc wants a multiple of the alignment
+	auto alignment = static_cast<std::size_t>(align);
+	size = size ? (size + alignment - 1) / alignment * alignment : alignment;
+#ifdef _WIN32
+	return _aligned_malloc(size, alignment);
+#else
+	return std::aligned_alloc(alignment, size);
+#endif
+}
+
+static void deallocate(void* ptr, std::align_val_t) {
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+BENCH_NOINLINE void* operator new(std::size_t size) {
+	if (auto ptr = allocate(size)) return ptr;
+	throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void* operator new[](std::size_t size) {
+	if (auto ptr = allocate(size)) return ptr;
+	throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+BENCH_NOINLINE void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return allocate(size);
+}
+
+BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t align) {
+	if (auto ptr = allocate(size, align)) return ptr;
+	throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void* operator new[](std::size_t size, std::align_val_t align) {
+	if (auto ptr = allocate(size, align)) return ptr;
+	throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	return allocate(size, align);
+}
+
+BENCH_NOINLINE void* operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+	return allocate(size, align);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t align) noexcept {
+	deallocate(ptr, align);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, std::align_val_t align) noexcept {
+	deallocate(ptr, align);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t align) noexcept {
+	deallocate(ptr, align);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, std::size_t, std::align_val_t align) noexcept {
+	deallocate(ptr, align);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept {
+	deallocate(ptr, align);
+}
+
+BENCH_NOINLINE void operator delete[](void* ptr, std::align_val_t align, const std::nothrow_t&) noexcept {
+	deallocate(ptr, align);
+}
+
+struct Sample {
+	double m_wallMs = 0;
+	std::size_t m_allocations = 0;
+	std::size_t m_bytes = 0;
+	std::size_t m_peakKb = 0;	//peak resident set of the process that ran the script
+	bool m_ok = false;			//no errors, and the script ran to the end
+};
+
+struct Result {
+	std::string m_name;
+	std::string m_backend;
+	std::vector<Sample> m_runs;
+
+	//! The fastest run is the one least disturbed by the rest of the machine
+	const Sample& best() const {
+		return *std::min_element(m_runs.begin(), m_runs.end(), [](auto& a, auto& b) { return a.m_wallMs < b.m_wallMs; });
+	}
+	bool ok() const {
+		return std::all_of(m_runs.begin(), m_runs.end(), [](auto& run) { return run.m_ok; });
+	}
+};
+
+//! Runs the script in this process, with its output thrown away
+static Sample runScript(const std::string& path, bool treeWalk) {
+	auto& proto = Proto::getInstance();
+	proto.setTreeWalk(treeWalk);
+	proto.setErr(false);
+	proto.setRuntimeError(false);
+
+	std::cout.flush();
+	std::cout.setstate(std::ios::badbit);
+
+	Sample sample;
+	auto allocs = allocations;
+	auto bytes = allocatedBytes;
+	auto start = std::chrono::steady_clock::now();
+	proto.runFile(path);
+	sample.m_wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	sample.m_allocations = allocations - allocs;
+	sample.m_bytes = allocatedBytes - bytes;
+	sample.m_ok = !proto.hadError() && !proto.hadRuntimeError();
+
+	std::cout.clear();
+	return sample;
+}
+
+#ifdef _WIN32
+//! No fork, so every run shares this process and the peak is the highest so far
+static Sample measure(const std::string& path, bool treeWalk) {
+	auto sample = runScript(path, treeWalk);
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		sample.m_peakKb = counters.PeakWorkingSetSize / 1024;
+	}
+	return sample;
+}
+#else
+//! Each run gets a fresh child, so the peak resident set is the script's alone and nothing
+//! it leaves behind (globals, GC generations) carries over to the next run. The child
+//! sends its sample back through a pipe, a script that exits early sends nothing.
+static Sample measure(const std::string& path, bool treeWalk) {
+	int fds[2];
+	if (pipe(fds) != 0) return {};
+
+	auto pid = fork();
+	if (pid == 0) {
+		close(fds[0]);
+		auto sample = runScript(path, treeWalk);
+		rusage usage{};
+		getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+		sample.m_peakKb = usage.ru_maxrss / 1024;	//bytes on macOS
+#else
+		sample.m_peakKb = usage.ru_maxrss;
+#endif
+		auto written = write(fds[1], &sample, sizeof(sample));
+		_exit(written == sizeof(sample) ? 0 : 1);
+	}
+	close(fds[1]);
+
+	Sample sample;
+	if (pid < 0 || read(fds[0], &sample, sizeof(sample)) != sizeof(sample)) sample.m_ok = false;
+	close(fds[0]);
+	if (pid > 0) waitpid(pid, nullptr, 0);
+	return sample;
+}
+#endif
+
+static void printTable(const std::vector<Result>& results, std::ostream& out) {
+	out << std::left << std::setw(18) << "benchmark" << std::setw(11) << "backend" << std::right
+		<< std::setw(10) << "wall ms" << std::setw(12) << "allocs" << std::setw(12) << "alloc KB" << std::setw(10) << "peak KB" << '\n';
+	for (auto& result : results) {
+		auto& best = result.best();
+		out << std::left << std::setw(18) << result.m_name << std::setw(11) << result.m_backend << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(10) << best.m_wallMs << std::setw(12) << best.m_allocations << std::setw(12) << best.m_bytes / 1024 << std::setw(10) << best.m_peakKb
+			<< (result.ok() ? "" : "  FAILED") << '\n';
+	}
+}
+
+//! Names are file stems and backends are fixed words, so nothing needs escaping
+static void writeJson(const std::vector<Result>& results, std::size_t runs, std::ostream& out) {
+	out << std::fixed << std::setprecision(3) << "{\n  \"runs\": " << runs << ",\n  \"benchmarks\": [";
+	for (std::size_t i = 0; i < results.size(); i++) {
+		auto& result = results[i];
+		auto& best = result.best();
+		out << (i ? "," : "") << "\n    {\"name\": \"" << result.m_name << "\", \"backend\": \"" << result.m_backend
+			<< "\", \"ok\": " << (result.ok() ? "true" : "false")
+			<< ", \"wall_ms\": " << best.m_wallMs << ", \"wall_ms_runs\": [";
+		for (std::size_t j = 0; j < result.m_runs.size(); j++) {
+			out << (j ? ", " : "") << result.m_runs[j].m_wallMs;
+		}
+		out << "], \"allocations\": " << best.m_allocations << ", \"allocated_bytes\": " << best.m_bytes
+			<< ", \"peak_rss_kb\": " << best.m_peakKb << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+	namespace fs = std::filesystem;
+	fs::path dir = "bench/programs";
+	std::string json = "proto-bench.json";
+	std::size_t runs = 3;
+	bool vm = true, treeWalk = true;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg.rfind("--runs=", 0) == 0 && arg.size() > 7 && arg.find_first_not_of("0123456789", 7) == std::string::npos && std::stoul(arg.substr(7)) > 0) {
+			runs = std::stoul(arg.substr(7));
+		}
+		else if (arg.rfind("--json=", 0) == 0 && arg.size() > 7) {
+			json = arg.substr(7);
+		}
+		else if (arg == "--vm") {
+			treeWalk = false;
+		}
+		else if (arg == "--tree-walk") {
+			vm = false;
+		}
+		else if (arg.rfind("--", 0) != 0) {
+			dir = arg;
+		}
+		else {
+			std::cerr << "Usage: proto-bench [--runs=N] [--json=FILE] [--vm | --tree-walk] [directory]\n";
+			return EXIT_UNEXPECTED_ARGS;
+		}
+	}
+	if (!vm && !treeWalk) vm = treeWalk = true;
+	std::vector<std::pair<std::string, bool>> backends;
+	if (vm) backends.push_back({ "vm", false });
+	if (treeWalk) backends.push_back({ "tree-walk", true });
+
+	std::error_code err;
+	std::vector<fs::path> scripts;
+	for (auto& entry : fs::directory_iterator(dir, err)) {
+		if (entry.is_regular_file() && entry.path().extension() == ".pr") scripts.push_back(entry.path());
+	}
+	if (scripts.empty()) {
+		std::cerr << "No .pr files found in " << dir.string() << '\n';
+		return EXIT_UNEXPECTED_ARGS;
+	}
+	std::sort(scripts.begin(), scripts.end());
+
+	//! Every run compiles from scratch, the cache would hide the front end's cost
+	BytecodeCache::getInstance().setEnabled(false);
+
+	std::vector<Result> results;
+	for (auto& script : scripts) {
+		for (auto& [backend, walk] : backends) {
+			Result result{ script.stem().string(), backend, {} };
+			for (std::size_t i = 0; i < runs; i++) {
+				result.m_runs.push_back(measure(script.string(), walk));
+			}
+			results.push_back(std::move(result));
+		}
+	}
+
+	printTable(results, std::cout);
+	std::ofstream file{ json };
+	writeJson(results, runs, file);
+	std::cout << (file ? "\nResults written to " + json : "\nCouldn't write " + json) << '\n';
+
+	bool ok = std::all_of(results.begin(), results.end(), [](auto& result) { return result.ok(); });
+	return ok ? EXIT_SUCCESS : EXIT_BENCH_FAILED;
+}
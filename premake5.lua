@@ -1,9 +1,18 @@
+newoption({
+    trigger = "stats",
+    description = "Count and time every tree walker visit and VM instruction, reported at exit"
+})
+
 workspace("Protonium")
     configurations({"Debug", "Release"})
     language("C++")
     cppdialect("C++17")
     platforms({"x86", "x64"})
 
+    filter("options:stats")
+        defines({"PROTO_STATS"})
+    filter({})
+
 project("Protonium")
     kind("ConsoleApp")
     targetname("proto")
@@ -12,6 +21,34 @@ project("Protonium")
 
     files("src/**.cpp", "src/**.hpp")
 
+    filter("system:not windows")
+        links({"pthread"})
+
+    filter("configurations:Debug")
+        defines({"DEBUG"})
+        symbols("On")
+
+    filter("configurations:Release")
+        defines({"NDEBUG"})
+        optimize("On")
+
+project("proto-bench")
+    kind("ConsoleApp")
+    targetname("proto-bench")
+    targetdir("bin/Output/%{cfg.buildcfg}-%{cfg.platform}")
+    objdir("bin/Intermediates/%{cfg.buildcfg}-%{cfg.platform}/bench")
+    debugdir(".")
+
+    files("bench/**.cpp", "src/**.cpp", "src/**.hpp")
+    removefiles("src/src.cpp")
+    includedirs("src")
+
+    filter("system:windows")
+        links({"psapi"})
+
+    filter("system:not windows")
+        links({"pthread"})
+
     filter("configurations:Debug")
         defines({"DEBUG"})
         symbols("On")
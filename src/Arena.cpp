@@ -0,0 +1,40 @@
+#include <cstdint>
+
+#include "includes/Arena.hpp"
+
+Arena::Arena(std::string source) : m_buffer(std::move(source)), m_source(m_buffer) {
+
+}
+
+Arena::Arena(std::unique_ptr<MappedFile> file) : m_file(std::move(file)), m_source(m_file->view()) {
+
+}
+
+void* Arena::allocate(std::size_t size, std::size_t align) {
+	auto pad = (align - reinterpret_cast<std::uintptr_t>(m_next) % align) % align;
+	if (m_next == nullptr || pad + size > m_left) {
+		auto blockSize = size + align > BLOCK_SIZE ? size + align : BLOCK_SIZE;
+		m_blocks.emplace_back(new std::byte[blockSize]);
+		m_next = m_blocks.back().get();
+		m_left = blockSize;
+		pad = (align - reinterpret_cast<std::uintptr_t>(m_next) % align) % align;
+	}
+	auto ptr = m_next + pad;
+	m_next = ptr + size;
+	m_left -= pad + size;
+	return ptr;
+}
+
+Arena::~Arena() {
+	for (auto& node : m_nodes) {
+		node.m_destroy(node.m_ptr);
+	}
+}
+
+std::string_view Arena::source() const {
+	return m_source;
+}
+
+std::string_view Arena::intern(std::string str) {
+	return *m_strings.insert(std::move(str)).first;
+}
@@ -0,0 +1,728 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <random>
+
+#include "includes/BytecodeCache.hpp"
+#include "includes/MappedFile.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <climits>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+#define PROTO_STRINGIFY(x) #x
+#define PROTO_TO_STRING(x) PROTO_STRINGIFY(x)
+#if defined(__VERSION__)
+#define PROTO_COMPILER __VERSION__
+#elif defined(_MSC_FULL_VER)
+#define PROTO_COMPILER "MSVC " PROTO_TO_STRING(_MSC_FULL_VER)
+#else
+#define PROTO_COMPILER ""
+#endif
+
+//! FNV-1a, for naming entries and checking their contents. Not collision resistant, an entry
+//! keeps the whole source to compare against.
+static std::uint64_t hashBytes(std::string_view bytes) {
+	std::uint64_t hash = 0xcbf29ce484222325;
+	for (auto c : bytes) {
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+//! The running executable, empty if it can't be found
+static std::filesystem::path executablePath() {
+#if defined(_WIN32)
+	wchar_t path[MAX_PATH];
+	auto len = ::GetModuleFileNameW(nullptr, path, MAX_PATH);
+	if (len == 0 || len == MAX_PATH) return {};
+	return std::filesystem::path(path, path + len);
+#elif defined(__APPLE__)
+	char path[PATH_MAX];
+	std::uint32_t size = sizeof(path);
+	if (::_NSGetExecutablePath(path, &size) != 0) return {};
+	return path;
+#else
+	return "/proc/self/exe";
+#endif
+}
+
+//! Identifies the build that wrote an entry by the executable's size and modification time,
+//! which relinking it after a change to any file gives new ones. 0 if they can't be read,
+//! then nothing is cached.
+static std::uint64_t buildId() {
+	static const auto id = [] {
+		std::error_code err;
+		auto exe = executablePath();
+		auto size = std::filesystem::file_size(exe, err);
+		if (err) return std::uint64_t{ 0 };
+		auto time = std::filesystem::last_write_time(exe, err);
+		if (err) return std::uint64_t{ 0 };
+		auto build = std::to_string(size) + " " + std::to_string(time.time_since_epoch().count()) + " " PROTO_COMPILER;
+		return hashBytes(build) | 1;
+	}();
+	return id;
+}
+
+//! Entries are only ever read back on the machine that wrote them, so numbers are stored
+//! in native byte order
+class CacheWriter {
+public:
+	std::string m_out;
+	bool m_ok = true;
+public:
+	template <typename T>
+	void write(T val) {
+		m_out.append(reinterpret_cast<const char*>(&val), sizeof(T));
+	}
+	void writeStr(std::string_view str) {
+		write<std::uint32_t>(str.size());
+		m_out.append(str);
+	}
+	void writeToken(const Token& tok) {
+		writeStr(tok.lexeme());
+		write<std::uint32_t>(tok.getLine());
+		write<std::uint8_t>(static_cast<std::uint8_t>(tok.getType()));
+		write<std::uint8_t>(static_cast<std::uint8_t>(tok.getlType()));
+	}
+	void writeFunction(const std::string& name, const std::vector<Token>& params, const Chunk& chunk, std::size_t scopeSize);
+};
+
+class CacheReader {
+private:
+	const char* m_ptr;
+	const char* m_end;
+	std::shared_ptr<Arena> m_unit;	//holds the names of every chunk read
+public:
+	bool m_ok = true;
+public:
+	CacheReader(std::string_view bytes) : m_ptr(bytes.data()), m_end(bytes.data() + bytes.size()), m_unit(std::make_shared<Arena>("")) {}
+
+	template <typename T>
+	T read() {
+		T val{};
+		if (static_cast<std::size_t>(m_end - m_ptr) < sizeof(T)) {
+			m_ok = false;
+			return val;
+		}
+		std::memcpy(&val, m_ptr, sizeof(T));
+		m_ptr += sizeof(T);
+		return val;
+	}
+	std::string_view readStr() {
+		auto len = read<std::uint32_t>();
+		if (!m_ok || static_cast<std::size_t>(m_end - m_ptr) < len) {
+			m_ok = false;
+			return {};
+		}
+		std::string_view str(m_ptr, len);
+		m_ptr += len;
+		return str;
+	}
+	Token readToken() {
+		auto lexeme = m_unit->intern(std::string(readStr()));
+		auto line = read<std::uint32_t>();
+		auto type = static_cast<TokenType>(read<std::uint8_t>());
+		auto ltype = static_cast<LiteralType>(read<std::uint8_t>());
+		return Token(type, lexeme, line, ltype);
+	}
+	obj_ptr<CompiledFunction> readFunction();
+	bool atEnd() const {
+		return m_ptr == m_end;
+	}
+};
+
+enum class ConstantTag : std::uint8_t {
+	NUM,
+	STR,
+	NIX,
+	TRUE,
+	FALSE,
+	FUNCTION
+};
+
+void CacheWriter::writeFunction(const std::string& name, const std::vector<Token>& params, const Chunk& chunk, std::size_t scopeSize) {
+	writeStr(name);
+	write<std::uint32_t>(scopeSize);
+	write<std::uint32_t>(params.size());
+	for (auto& param : params) {
+		writeToken(param);
+	}
+
+	write<std::uint32_t>(chunk.m_code.size());
+	m_out.append(reinterpret_cast<const char*>(chunk.m_code.data()), chunk.m_code.size());
+
+	//! One line per byte of code, so they're stored as runs
+	std::vector<std::pair<std::size_t, std::uint32_t>> runs;
+	for (auto line : chunk.m_lines) {
+		if (!runs.empty() && runs.back().first == line) runs.back().second++;
+		else runs.push_back({ line, 1 });
+	}
+	write<std::uint32_t>(runs.size());
+	for (auto& [line, count] : runs) {
+		write<std::uint32_t>(line);
+		write<std::uint32_t>(count);
+	}
+
+	write<std::uint32_t>(chunk.m_constants.size());
+	for (auto& val : chunk.m_constants) {
+		if (val.isNum()) {
+			write(ConstantTag::NUM);
+			write(val.asNum());
+		}
+		else if (val.isStr()) {
+			write(ConstantTag::STR);
+			writeStr(val.asStr());
+		}
+		else if (val.isNix()) {
+			write(ConstantTag::NIX);
+		}
+		else if (val.isBool()) {
+			write(val.asBool() ? ConstantTag::TRUE : ConstantTag::FALSE);
+		}
+		else if (auto fn = val.isCallable() ? dynamic_cast<CompiledFunction*>(val.as<Callable>()) : nullptr) {
+			write(ConstantTag::FUNCTION);
+			writeFunction(fn->m_name, fn->m_params, *fn->m_chunk, fn->m_scopeSize);
+		}
+		else {
+			m_ok = false;
+		}
+	}
+
+	write<std::uint32_t>(chunk.m_names.size());
+	for (auto& name : chunk.m_names) {
+		writeToken(name);
+	}
+
+	write<std::uint32_t>(chunk.m_captures.size());
+	for (auto& captured : chunk.m_captures) {
+		write<std::uint8_t>(captured.m_isUpvalue);
+		write<std::uint8_t>(captured.m_inFrame);
+		write<std::uint32_t>(captured.m_depth);
+		write<std::uint32_t>(captured.m_slot);
+	}
+
+	write<std::uint32_t>(chunk.m_handlers.size());
+	for (auto& handler : chunk.m_handlers) {
+		write<std::uint32_t>(handler.m_start);
+		write<std::uint32_t>(handler.m_end);
+		write<std::uint32_t>(handler.m_scopeDepth);
+		write<std::uint32_t>(handler.m_stackDepth);
+	}
+}
+
+//! Checks that the code of a chunk read back runs the way compiled code does, so that a
+//! damaged or planted entry can't make the VM read or write outside of what it owns. Every
+//! instruction is decoded and its constant, name, slot and upvalue operands bounds checked.
+//! Then every path through the code is followed, including the ones a Handler resumes, with
+//! the scopes it has open and what it keeps on the stack: those must agree wherever paths
+//! meet, locals must be in an open scope, nothing pops what it didn't push and no path runs
+//! past the end of the code.
+class CodeVerifier {
+private:
+	//! Only FOR_ITER reads stack values without checking them
+	enum class Slot : std::uint8_t {
+		ANY,
+		LIST,
+		NUM
+	};
+	struct State {
+		std::vector<std::size_t> m_scopes;	//slot counts of the open scopes, innermost last
+		std::vector<Slot> m_stack;			//the values above the frame's slots
+	};
+	struct Instr {
+		OpCode m_op;
+		std::size_t m_offset;
+		std::size_t m_next;
+		std::size_t m_byte;			//u8 operand
+		std::size_t m_shorts[4];	//u16 operands, in order
+	};
+	static constexpr std::size_t NONE = static_cast<std::size_t>(-1);
+
+	const Chunk& m_chunk;
+	std::size_t m_scopeSize;
+	std::vector<Instr> m_instrs;
+	std::vector<std::size_t> m_index;	//instruction starting at each offset, NONE inside one
+	std::vector<std::optional<State>> m_states;
+	std::vector<std::size_t> m_worklist;
+private:
+	bool decode();
+	bool local(const State& state, std::size_t depth, std::size_t slot) const;
+	bool flow(std::size_t offset, const State& state);
+	bool step(std::size_t index);
+public:
+	CodeVerifier(const Chunk& chunk, std::size_t scopeSize) : m_chunk(chunk), m_scopeSize(scopeSize) {}
+	bool verify();
+};
+
+bool CodeVerifier::decode() {
+	auto& code = m_chunk.m_code;
+	m_index.assign(code.size(), NONE);
+
+	std::size_t ip = 0;
+	while (ip < code.size()) {
+		Instr instr{ static_cast<OpCode>(code[ip]), ip, 0, 0, {} };
+		m_index[ip++] = m_instrs.size();
+
+		std::size_t bytes = 0;
+		std::size_t shorts = 0;
+		switch (instr.m_op) {
+		case OpCode::NIX: case OpCode::TRUE: case OpCode::FALSE: case OpCode::POP:
+		case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::DIVIDE: case OpCode::POWER:
+		case OpCode::GREATER: case OpCode::GT_EQUAL: case OpCode::LESS: case OpCode::LT_EQUAL:
+		case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::NEGATE: case OpCode::NOT:
+		case OpCode::POP_SCOPE: case OpCode::INDEX: case OpCode::INDEX_ASSIGN: case OpCode::ITERABLE: case OpCode::RETURN:
+			break;
+		case OpCode::CONSTANT: case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL: case OpCode::STRICT_SET_GLOBAL:
+		case OpCode::JUMP: case OpCode::JUMP_IF_FALSE: case OpCode::JUMP_IF_TRUE: case OpCode::LOOP:
+		case OpCode::PUSH_SCOPE: case OpCode::LIST: case OpCode::CLOSURE:
+			shorts = 1;
+			break;
+		case OpCode::GET_FRAME: case OpCode::SET_FRAME: case OpCode::STRICT_SET_FRAME:
+		case OpCode::GET_UPVALUE: case OpCode::STRICT_SET_UPVALUE:
+			shorts = 2;
+			break;
+		case OpCode::GET_LOCAL: case OpCode::SET_LOCAL: case OpCode::STRICT_SET_LOCAL:
+			shorts = 3;
+			break;
+		case OpCode::FOR_ITER:
+			shorts = 4;
+			break;
+		case OpCode::RANGE: case OpCode::CALL: case OpCode::TAIL_CALL:
+			bytes = 1;
+			break;
+		case OpCode::CALL_GLOBAL: case OpCode::TAIL_CALL_GLOBAL:
+			bytes = 1;
+			shorts = 1;
+			break;
+		default:
+			return false;
+		}
+		if (code.size() - ip < bytes + shorts * 2) return false;
+		if (bytes) instr.m_byte = code[ip++];
+		for (std::size_t i = 0; i < shorts; i++) {
+			instr.m_shorts[i] = static_cast<std::size_t>((code[ip] << 8) | code[ip + 1]);
+			ip += 2;
+		}
+		instr.m_next = ip;
+
+		auto& operands = instr.m_shorts;
+		auto name = operands[0] < m_chunk.m_names.size();
+		switch (instr.m_op) {
+		case OpCode::CONSTANT:
+			if (operands[0] >= m_chunk.m_constants.size()) return false;
+			break;
+		case OpCode::CLOSURE: {
+			if (operands[0] >= m_chunk.m_constants.size()) return false;
+			auto& val = m_chunk.m_constants[operands[0]];
+			auto fn = val.isCallable() ? dynamic_cast<CompiledFunction*>(val.as<Callable>()) : nullptr;
+			if (!fn) return false;
+			for (auto& captured : fn->chunk().m_captures) {
+				if (captured.m_isUpvalue && captured.m_slot >= m_chunk.m_captures.size()) return false;
+				if (!captured.m_isUpvalue && captured.m_inFrame && captured.m_slot >= m_scopeSize) return false;
+			}
+			break;
+		}
+		case OpCode::GET_FRAME: case OpCode::SET_FRAME: case OpCode::STRICT_SET_FRAME:
+			if (!name || operands[1] >= m_scopeSize) return false;
+			break;
+		case OpCode::GET_UPVALUE: case OpCode::STRICT_SET_UPVALUE:
+			if (!name || operands[1] >= m_chunk.m_captures.size()) return false;
+			break;
+		case OpCode::GET_LOCAL: case OpCode::SET_LOCAL: case OpCode::STRICT_SET_LOCAL:
+		case OpCode::GET_GLOBAL: case OpCode::SET_GLOBAL: case OpCode::STRICT_SET_GLOBAL:
+		case OpCode::CALL_GLOBAL: case OpCode::TAIL_CALL_GLOBAL: case OpCode::FOR_ITER:
+			if (!name) return false;
+			break;
+		default:
+			break;
+		}
+		m_instrs.push_back(instr);
+	}
+	return true;
+}
+
+bool CodeVerifier::local(const State& state, std::size_t depth, std::size_t slot) const {
+	auto& scopes = state.m_scopes;
+	return depth < scopes.size() && slot < scopes[scopes.size() - 1 - depth];
+}
+
+//! A path reaching offset with state, the first one to get there decides what it must be
+bool CodeVerifier::flow(std::size_t offset, const State& state) {
+	if (offset >= m_index.size() || m_index[offset] == NONE) return false;
+	auto index = m_index[offset];
+	auto& known = m_states[index];
+	if (!known) {
+		known = state;
+		m_worklist.push_back(index);
+		return true;
+	}
+	if (known->m_scopes != state.m_scopes || known->m_stack.size() != state.m_stack.size()) return false;
+
+	bool changed = false;
+	for (std::size_t i = 0; i < state.m_stack.size(); i++) {
+		if (known->m_stack[i] != state.m_stack[i] && known->m_stack[i] != Slot::ANY) {
+			known->m_stack[i] = Slot::ANY;
+			changed = true;
+		}
+	}
+	if (changed) m_worklist.push_back(index);
+	return true;
+}
+
+bool CodeVerifier::step(std::size_t index) {
+	auto& instr = m_instrs[index];
+	auto state = *m_states[index];
+	auto& stack = state.m_stack;
+	auto& operands = instr.m_shorts;
+
+	std::size_t pops = 0;
+	switch (instr.m_op) {
+	case OpCode::POP: case OpCode::NEGATE: case OpCode::NOT: case OpCode::ITERABLE: case OpCode::RETURN:
+	case OpCode::JUMP_IF_FALSE: case OpCode::JUMP_IF_TRUE:
+	case OpCode::SET_LOCAL: case OpCode::STRICT_SET_LOCAL: case OpCode::SET_FRAME: case OpCode::STRICT_SET_FRAME:
+	case OpCode::SET_GLOBAL: case OpCode::STRICT_SET_GLOBAL: case OpCode::STRICT_SET_UPVALUE:
+		pops = 1;
+		break;
+	case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::DIVIDE: case OpCode::POWER:
+	case OpCode::GREATER: case OpCode::GT_EQUAL: case OpCode::LESS: case OpCode::LT_EQUAL:
+	case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::INDEX: case OpCode::FOR_ITER:
+		pops = 2;
+		break;
+	case OpCode::INDEX_ASSIGN:
+		pops = 3;
+		break;
+	case OpCode::LIST:
+		pops = operands[0];
+		break;
+	case OpCode::RANGE:
+		pops = instr.m_byte ? 3 : 2;
+		break;
+	case OpCode::CALL: case OpCode::CALL_GLOBAL: case OpCode::TAIL_CALL: case OpCode::TAIL_CALL_GLOBAL:
+		pops = instr.m_byte + 1;
+		break;
+	default:
+		break;
+	}
+	if (stack.size() < pops) return false;
+
+	//! An error anywhere in a handler's range resumes at its end, with what's below it kept
+	for (auto& handler : m_chunk.m_handlers) {
+		if (instr.m_offset < handler.m_start || instr.m_offset >= handler.m_end) continue;
+		if (state.m_scopes.size() < handler.m_scopeDepth || stack.size() - pops < handler.m_stackDepth) return false;
+		State resumed{ { state.m_scopes.begin(), state.m_scopes.begin() + handler.m_scopeDepth }, { stack.begin(), stack.begin() + handler.m_stackDepth } };
+		if (!flow(handler.m_end, resumed)) return false;
+	}
+
+	auto pop = [&](std::size_t count) { stack.resize(stack.size() - count); };
+	switch (instr.m_op) {
+	case OpCode::CONSTANT:
+		stack.push_back(m_chunk.m_constants[operands[0]].isNum() ? Slot::NUM : Slot::ANY);
+		break;
+	case OpCode::NIX: case OpCode::TRUE: case OpCode::FALSE:
+	case OpCode::GET_FRAME: case OpCode::GET_GLOBAL: case OpCode::GET_UPVALUE:
+		stack.push_back(Slot::ANY);
+		break;
+	case OpCode::GET_LOCAL:
+		if (!local(state, operands[1], operands[2])) return false;
+		stack.push_back(Slot::ANY);
+		break;
+	case OpCode::SET_LOCAL: case OpCode::STRICT_SET_LOCAL:
+		if (!local(state, operands[1], operands[2])) return false;
+		break;
+	case OpCode::POP:
+		pop(1);
+		break;
+	case OpCode::NEGATE: case OpCode::NOT:
+		stack.back() = Slot::ANY;
+		break;
+	case OpCode::ITERABLE:
+		stack.back() = Slot::LIST;
+		break;
+	case OpCode::JUMP_IF_FALSE: case OpCode::JUMP_IF_TRUE:
+		pop(1);
+		if (!flow(instr.m_next + operands[0], state)) return false;
+		break;
+	case OpCode::JUMP:
+		return flow(instr.m_next + operands[0], state);
+	case OpCode::LOOP:
+		return operands[0] <= instr.m_next && flow(instr.m_next - operands[0], state);
+	case OpCode::PUSH_SCOPE:
+		state.m_scopes.push_back(operands[0]);
+		break;
+	case OpCode::POP_SCOPE:
+		if (state.m_scopes.empty()) return false;
+		state.m_scopes.pop_back();
+		break;
+	case OpCode::FOR_ITER:
+		if (stack[stack.size() - 2] != Slot::LIST || stack.back() != Slot::NUM) return false;
+		if (!local(state, operands[1], operands[2])) return false;
+		if (!flow(instr.m_next + operands[3], state)) return false;
+		break;
+	case OpCode::CLOSURE: {
+		auto fn = static_cast<CompiledFunction*>(m_chunk.m_constants[operands[0]].as<Callable>());
+		for (auto& captured : fn->chunk().m_captures) {
+			if (!captured.m_isUpvalue && !captured.m_inFrame && !local(state, captured.m_depth, captured.m_slot)) return false;
+		}
+		stack.push_back(Slot::ANY);
+		break;
+	}
+	case OpCode::ADD: case OpCode::SUBTRACT: case OpCode::MULTIPLY: case OpCode::DIVIDE: case OpCode::POWER:
+	case OpCode::GREATER: case OpCode::GT_EQUAL: case OpCode::LESS: case OpCode::LT_EQUAL:
+	case OpCode::EQUAL: case OpCode::NOT_EQUAL: case OpCode::INDEX: case OpCode::INDEX_ASSIGN:
+	case OpCode::LIST: case OpCode::RANGE:
+	case OpCode::CALL: case OpCode::CALL_GLOBAL: case OpCode::TAIL_CALL: case OpCode::TAIL_CALL_GLOBAL:
+		pop(pops);
+		stack.push_back(Slot::ANY);
+		break;
+	case OpCode::RETURN:
+		return true;
+	default:
+		//! Assignments leave their value where it is
+		break;
+	}
+	return flow(instr.m_next, state);
+}
+
+bool CodeVerifier::verify() {
+	if (!decode() || m_instrs.empty()) return false;
+	for (auto& handler : m_chunk.m_handlers) {
+		if (handler.m_start > handler.m_end || handler.m_end >= m_index.size()) return false;
+	}
+
+	m_states.resize(m_instrs.size());
+	if (!flow(0, State{})) return false;
+	while (!m_worklist.empty()) {
+		auto index = m_worklist.back();
+		m_worklist.pop_back();
+		if (!step(index)) return false;
+	}
+	return true;
+}
+
+obj_ptr<CompiledFunction> CacheReader::readFunction() {
+	auto name = std::string(readStr());
+	auto scopeSize = read<std::uint32_t>();
+	std::vector<Token> params;
+	auto paramCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < paramCount && m_ok; i++) {
+		params.push_back(readToken());
+	}
+
+	auto chunk = std::make_shared<Chunk>();
+	chunk->m_unit = m_unit;
+
+	auto code = readStr();
+	chunk->m_code.assign(code.begin(), code.end());
+
+	auto runCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < runCount && m_ok; i++) {
+		auto line = read<std::uint32_t>();
+		auto count = read<std::uint32_t>();
+		if (chunk->m_lines.size() + count > chunk->m_code.size()) m_ok = false;
+		else chunk->m_lines.insert(chunk->m_lines.end(), count, line);
+	}
+	if (chunk->m_lines.size() != chunk->m_code.size()) m_ok = false;
+
+	auto constantCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < constantCount && m_ok; i++) {
+		switch (read<ConstantTag>()) {
+		case ConstantTag::NUM: chunk->m_constants.push_back(read<double>()); break;
+		case ConstantTag::STR: chunk->m_constants.push_back(std::string(readStr())); break;
+		case ConstantTag::NIX: chunk->m_constants.push_back(nullptr); break;
+		case ConstantTag::TRUE: chunk->m_constants.push_back(true); break;
+		case ConstantTag::FALSE: chunk->m_constants.push_back(false); break;
+		case ConstantTag::FUNCTION: {
+			auto fn = readFunction();
+			if (fn) chunk->m_constants.push_back(fn);
+			break;
+		}
+		default: m_ok = false;
+		}
+	}
+
+	auto nameCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < nameCount && m_ok; i++) {
+		chunk->addName(readToken());
+	}
+
+	auto captureCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < captureCount && m_ok; i++) {
+		auto isUpvalue = read<std::uint8_t>() != 0;
+		auto inFrame = read<std::uint8_t>() != 0;
+		auto depth = read<std::uint32_t>();
+		auto slot = read<std::uint32_t>();
+		chunk->m_captures.push_back({ true, depth, slot, isUpvalue, inFrame });
+	}
+
+	auto handlerCount = read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < handlerCount && m_ok; i++) {
+		Handler handler;
+		handler.m_start = read<std::uint32_t>();
+		handler.m_end = read<std::uint32_t>();
+		handler.m_scopeDepth = read<std::uint32_t>();
+		handler.m_stackDepth = read<std::uint32_t>();
+		chunk->m_handlers.push_back(handler);
+	}
+
+	if (!m_ok || !CodeVerifier(*chunk, scopeSize).verify()) {
+		m_ok = false;
+		return nullptr;
+	}
+	return make_obj<CompiledFunction>(name, params, chunk, scopeSize);
+}
+
+//! Only the user's own cache directory, the shared temporary one would let anyone plant entries
+BytecodeCache::BytecodeCache() {
+	auto absolute = [](const char* dir) { return dir && std::filesystem::path(dir).is_absolute(); };
+	if (auto dir = std::getenv("PROTO_CACHE_DIR")) {
+		m_dir = dir;
+	}
+#ifdef _WIN32
+	else if (auto dir = std::getenv("LOCALAPPDATA"); absolute(dir)) {
+		m_dir = std::filesystem::path(dir) / "proto";
+	}
+#else
+	else if (auto dir = std::getenv("XDG_CACHE_HOME"); absolute(dir)) {
+		m_dir = std::filesystem::path(dir) / "proto";
+	}
+	else if (auto home = std::getenv("HOME"); absolute(home)) {
+		m_dir = std::filesystem::path(home) / ".cache" / "proto";
+	}
+#endif
+	else m_enabled = false;
+}
+
+//! Creates the directory readable by the user alone. One that already exists is only
+//! used if the user owns it and nobody else can write to it, otherwise the cache is off.
+bool BytecodeCache::checkDir() {
+	if (m_dirChecked) return m_enabled;
+	m_dirChecked = true;
+
+	if (buildId() == 0) {
+		m_enabled = false;
+		return m_enabled;
+	}
+
+	std::error_code err;
+	std::filesystem::create_directories(m_dir.parent_path(), err);
+#ifndef _WIN32
+	struct stat info;
+	if (::mkdir(m_dir.c_str(), 0700) != 0 && errno != EEXIST) m_enabled = false;
+	else if (::lstat(m_dir.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) m_enabled = false;
+	else if (info.st_uid != ::geteuid() || (info.st_mode & (S_IWGRP | S_IWOTH)) != 0) m_enabled = false;
+#else
+	//! %LOCALAPPDATA% is the user's own
+	std::filesystem::create_directory(m_dir, err);
+	if (err || !std::filesystem::is_directory(m_dir, err)) m_enabled = false;
+#endif
+	return m_enabled;
+}
+
+BytecodeCache& BytecodeCache::getInstance() {
+	static BytecodeCache cache;
+	return cache;
+}
+
+std::filesystem::path BytecodeCache::entryPath(std::uint64_t hash) const {
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.pbc", static_cast<unsigned long long>(hash));
+	return m_dir / name;
+}
+
+void BytecodeCache::setEnabled(bool val) {
+	m_enabled = val;
+}
+
+bool BytecodeCache::isEnabled() const {
+	return m_enabled;
+}
+
+//! Layout: "PRBC", version (u32), build id (u64), source hash (u64), source length (u64),
+//! checksum of the body (u64), the source, then the body: the warnings and the script function
+obj_ptr<CompiledFunction> BytecodeCache::load(std::string_view source, Warnings& warnings) {
+	if (!m_enabled || !checkDir()) return nullptr;
+
+	auto hash = hashBytes(source);
+	MappedFile file(entryPath(hash).string());
+	if (!file.isOpen()) return nullptr;
+
+	CacheReader header(file.view());
+	auto magic = header.read<std::uint32_t>();
+	auto version = header.read<std::uint32_t>();
+	auto build = header.read<std::uint64_t>();
+	auto sourceHash = header.read<std::uint64_t>();
+	auto sourceSize = header.read<std::uint64_t>();
+	auto checksum = header.read<std::uint64_t>();
+	constexpr std::size_t headerSize = 40;
+	if (!header.m_ok || std::memcmp(&magic, "PRBC", 4) != 0 || version != FORMAT_VERSION || build != buildId() || sourceHash != hash || sourceSize != source.size()) {
+		return nullptr;
+	}
+	//! Another source with the same hash and length is easy to come up with
+	if (file.view().size() - headerSize < source.size() || file.view().substr(headerSize, source.size()) != source) {
+		return nullptr;
+	}
+	auto body = file.view().substr(headerSize + source.size());
+	if (hashBytes(body) != checksum) return nullptr;
+
+	CacheReader reader(body);
+	auto warningCount = reader.read<std::uint32_t>();
+	for (std::uint32_t i = 0; i < warningCount && reader.m_ok; i++) {
+		auto line = reader.read<std::uint32_t>();
+		warnings.emplace_back(line, std::string(reader.readStr()));
+	}
+	auto script = reader.readFunction();
+	if (!reader.m_ok || !reader.atEnd()) {
+		warnings.clear();
+		return nullptr;
+	}
+	return script;
+}
+
+void BytecodeCache::store(std::string_view source, const CompiledFunction& script, const Warnings& warnings) {
+	if (!m_enabled || !checkDir()) return;
+
+	CacheWriter body;
+	body.write<std::uint32_t>(warnings.size());
+	for (auto& [line, warning] : warnings) {
+		body.write<std::uint32_t>(line);
+		body.writeStr(warning);
+	}
+	body.writeFunction(script.m_name, script.m_params, *script.m_chunk, script.m_scopeSize);
+	if (!body.m_ok) return;
+
+	auto hash = hashBytes(source);
+	CacheWriter header;
+	header.m_out.append("PRBC");
+	header.write<std::uint32_t>(FORMAT_VERSION);
+	header.write<std::uint64_t>(buildId());
+	header.write<std::uint64_t>(hash);
+	header.write<std::uint64_t>(source.size());
+	header.write<std::uint64_t>(hashBytes(body.m_out));
+
+	//! Written to a temporary first so a reader never sees half an entry. The cache is only
+	//! an optimization, so failures are ignored.
+	std::error_code err;
+	auto path = entryPath(hash);
+	auto temp = path;
+	temp += "." + std::to_string(std::random_device()()) + ".tmp";
+	{
+		std::ofstream file{ temp, std::ios::binary };
+		file << header.m_out << source << body.m_out;
+		if (!file) err = std::make_error_code(std::errc::io_error);
+	}
+	if (!err) std::filesystem::rename(temp, path, err);
+	if (err) std::filesystem::remove(temp, err);
+}
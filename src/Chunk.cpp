@@ -0,0 +1,99 @@
+#include <cstring>
+
+#include "includes/Chunk.hpp"
+
+void Chunk::write(std::uint8_t byte, std::size_t line) {
+	m_code.push_back(byte);
+	m_lines.push_back(line);
+}
+
+void Chunk::write(OpCode op, std::size_t line) {
+	write(static_cast<std::uint8_t>(op), line);
+}
+
+void Chunk::writeShort(std::size_t val, std::size_t line) {
+	write(static_cast<std::uint8_t>((val >> 8) & 0xff), line);
+	write(static_cast<std::uint8_t>(val & 0xff), line);
+}
+
+std::size_t Chunk::addConstant(const Value& val) {
+	if (val.isNum()) {
+		//! By bits, so 0 and -0 stay apart
+		std::uint64_t bits;
+		auto num = val.asNum();
+		std::memcpy(&bits, &num, sizeof(bits));
+		auto [index, added] = m_numIndices.try_emplace(bits, m_constants.size());
+		if (added) m_constants.push_back(val);
+		return index->second;
+	}
+	if (val.isStr()) {
+		auto [index, added] = m_strIndices.try_emplace(val.asStr(), m_constants.size());
+		if (added) m_constants.push_back(val);
+		return index->second;
+	}
+	m_constants.push_back(val);
+	return m_constants.size() - 1;
+}
+
+//! Every occurrence of a name shares its entry, and so its GlobalCache
+std::size_t Chunk::addName(const Token& name) {
+	auto [index, added] = m_nameIndices.try_emplace(name.lexeme(), m_names.size());
+	if (added) {
+		m_names.push_back(name);
+		m_globals.emplace_back();
+	}
+	return index->second;
+}
+
+const char* opName(OpCode op) {
+	switch (op) {
+	case OpCode::CONSTANT: return "CONSTANT";
+	case OpCode::NIX: return "NIX";
+	case OpCode::TRUE: return "TRUE";
+	case OpCode::FALSE: return "FALSE";
+	case OpCode::POP: return "POP";
+	case OpCode::GET_LOCAL: return "GET_LOCAL";
+	case OpCode::SET_LOCAL: return "SET_LOCAL";
+	case OpCode::STRICT_SET_LOCAL: return "STRICT_SET_LOCAL";
+	case OpCode::GET_FRAME: return "GET_FRAME";
+	case OpCode::SET_FRAME: return "SET_FRAME";
+	case OpCode::STRICT_SET_FRAME: return "STRICT_SET_FRAME";
+	case OpCode::GET_GLOBAL: return "GET_GLOBAL";
+	case OpCode::SET_GLOBAL: return "SET_GLOBAL";
+	case OpCode::STRICT_SET_GLOBAL: return "STRICT_SET_GLOBAL";
+	case OpCode::GET_UPVALUE: return "GET_UPVALUE";
+	case OpCode::STRICT_SET_UPVALUE: return "STRICT_SET_UPVALUE";
+	case OpCode::ADD: return "ADD";
+	case OpCode::SUBTRACT: return "SUBTRACT";
+	case OpCode::MULTIPLY: return "MULTIPLY";
+	case OpCode::DIVIDE: return "DIVIDE";
+	case OpCode::POWER: return "POWER";
+	case OpCode::GREATER: return "GREATER";
+	case OpCode::GT_EQUAL: return "GT_EQUAL";
+	case OpCode::LESS: return "LESS";
+	case OpCode::LT_EQUAL: return "LT_EQUAL";
+	case OpCode::EQUAL: return "EQUAL";
+	case OpCode::NOT_EQUAL: return "NOT_EQUAL";
+	case OpCode::NEGATE: return "NEGATE";
+	case OpCode::NOT: return "NOT";
+	case OpCode::JUMP: return "JUMP";
+	case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
+	case OpCode::JUMP_IF_TRUE: return "JUMP_IF_TRUE";
+	case OpCode::LOOP: return "LOOP";
+	case OpCode::PUSH_SCOPE: return "PUSH_SCOPE";
+	case OpCode::POP_SCOPE: return "POP_SCOPE";
+	case OpCode::LIST: return "LIST";
+	case OpCode::RANGE: return "RANGE";
+	case OpCode::INDEX: return "INDEX";
+	case OpCode::INDEX_ASSIGN: return "INDEX_ASSIGN";
+	case OpCode::ITERABLE: return "ITERABLE";
+	case OpCode::FOR_ITER: return "FOR_ITER";
+	case OpCode::CLOSURE: return "CLOSURE";
+	case OpCode::CALL: return "CALL";
+	case OpCode::CALL_GLOBAL: return "CALL_GLOBAL";
+	case OpCode::TAIL_CALL: return "TAIL_CALL";
+	case OpCode::TAIL_CALL_GLOBAL: return "TAIL_CALL_GLOBAL";
+	case OpCode::RETURN: return "RETURN";
+	}
+	return "UNKNOWN";
+}
@@ -0,0 +1,32 @@
+#include "includes/CompiledFunc.hpp"
+#include "includes/VM.hpp"
+
+CompiledFunction::CompiledFunction(const std::string& name, const std::vector<Token>& params, std::shared_ptr<Chunk> chunk, std::size_t scopeSize) : m_name(name), m_params(params), m_chunk(chunk), m_scopeSize(scopeSize) {
+
+}
+
+int CompiledFunction::arity() {
+	return m_params.size();
+}
+
+std::string CompiledFunction::info() {
+	return (m_name == "") ? "<Proto::generic::userfn::lambda>" : "<Proto::generic::userfn " + m_name + ">";
+}
+
+Value CompiledFunction::call(Args args) {
+	return VM::getInstance().call(*this, args);
+}
+
+Chunk& CompiledFunction::chunk() {
+	return *m_chunk;
+}
+
+void CompiledFunction::trace(Tracer& tracer) {
+	for (auto& upvalue : m_upvalues) {
+		tracer.visit(upvalue.get());
+	}
+}
+
+void CompiledFunction::clearRefs() {
+	m_upvalues.clear();
+}
@@ -0,0 +1,530 @@
+#include <limits>
+
+#include "includes/Compiler.hpp"
+#include "includes/Interpreter.hpp"
+#include "includes/Lambda.hpp"
+#include "proto.hpp"
+
+constexpr std::size_t maxShort = std::numeric_limits<std::uint16_t>::max();
+
+Compiler::Compiler(std::shared_ptr<Arena> unit) : m_unit(std::move(unit)) {
+
+}
+
+//! Only the first one is kept, compiling goes on so that real errors are still reported
+void Compiler::overLimit(const char* limit) {
+	if (m_limit != nullptr) return;
+	m_limit = limit;
+	m_limitLine = m_line;
+}
+
+const char* Compiler::limit() const {
+	return m_limit;
+}
+
+std::size_t Compiler::limitLine() const {
+	return m_limitLine;
+}
+
+Chunk& Compiler::chunk() {
+	return *m_chunk;
+}
+
+void Compiler::emit(OpCode op) {
+	chunk().write(op, m_line);
+}
+
+void Compiler::emit(std::uint8_t byte) {
+	chunk().write(byte, m_line);
+}
+
+void Compiler::emitShort(std::size_t val) {
+	chunk().writeShort(val, m_line);
+}
+
+void Compiler::emitConstant(const Value& val) {
+	auto index = chunk().addConstant(val);
+	if (index > maxShort) {
+		overLimit("Too many constants in one function.");
+	}
+	emit(OpCode::CONSTANT);
+	emitShort(index);
+}
+
+std::size_t Compiler::emitName(OpCode op, const Token& name) {
+	auto index = chunk().addName(name);
+	if (index > maxShort) {
+		overLimit("Too many identifiers in one function.");
+	}
+	emit(op);
+	emitShort(index);
+	return index;
+}
+
+std::size_t Compiler::emitVariable(OpCode localOp, OpCode globalOp, const Resolution& resolved, const Token& name) {
+	if (!resolved.m_isLocal) {
+		//! Either the variable is global or it doesn't exist.
+		return emitName(globalOp, name);
+	}
+	if (resolved.m_inFrame) {
+		if (resolved.m_slot > maxShort) {
+			overLimit("Too many local variables.");
+		}
+		auto frameOp = localOp == OpCode::GET_LOCAL ? OpCode::GET_FRAME : localOp == OpCode::SET_LOCAL ? OpCode::SET_FRAME : OpCode::STRICT_SET_FRAME;
+		auto index = emitName(frameOp, name);
+		emitShort(resolved.m_slot);
+		return index;
+	}
+	if (resolved.m_isUpvalue) {
+		//! Only reads and strict assignments reach past the function's own scopes
+		auto index = emitName(localOp == OpCode::GET_LOCAL ? OpCode::GET_UPVALUE : OpCode::STRICT_SET_UPVALUE, name);
+		emitShort(resolved.m_slot);
+		return index;
+	}
+	if (resolved.m_depth > maxShort || resolved.m_slot > maxShort) {
+		overLimit("Too many nested scopes or local variables.");
+	}
+	auto index = emitName(localOp, name);
+	emitShort(resolved.m_depth);
+	emitShort(resolved.m_slot);
+	return index;
+}
+
+std::size_t Compiler::emitJump(OpCode op) {
+	emit(op);
+	emitShort(maxShort);
+	return chunk().m_code.size() - 2;
+}
+
+void Compiler::patchJump(std::size_t offset) {
+	//! -2 to account for the operand of the jump itself
+	auto jump = chunk().m_code.size() - offset - 2;
+	if (jump > maxShort) {
+		overLimit("Too much code to jump over.");
+	}
+	chunk().m_code[offset] = (jump >> 8) & 0xff;
+	chunk().m_code[offset + 1] = jump & 0xff;
+}
+
+void Compiler::emitLoop(std::size_t start) {
+	emit(OpCode::LOOP);
+	auto offset = chunk().m_code.size() - start + 2;
+	if (offset > maxShort) {
+		overLimit("Loop body too large.");
+	}
+	emitShort(offset);
+}
+
+//! The Resolver elides scopes without variables, so those get no environment either
+void Compiler::beginScope(std::size_t scopeSize) {
+	if (scopeSize == 0) return;
+	if (scopeSize > maxShort) {
+		overLimit("Too many local variables.");
+	}
+	emit(OpCode::PUSH_SCOPE);
+	emitShort(scopeSize);
+	m_scopeDepth++;
+}
+
+void Compiler::endScope(std::size_t scopeSize) {
+	if (scopeSize == 0) return;
+	m_scopeDepth--;
+	emit(OpCode::POP_SCOPE);
+}
+
+void Compiler::emitScopeExits(std::size_t depth) {
+	for (auto i = depth; i < m_scopeDepth; i++) {
+		emit(OpCode::POP_SCOPE);
+	}
+}
+
+void Compiler::compile(const Stmt_ptr& stmt) {
+	stmt->accept(this);
+}
+
+void Compiler::compile(const Expr_ptr& expr) {
+	expr->accept(this);
+}
+
+void Compiler::compileLoopBody(const Stmt_ptr& body) {
+	//! Like the interpreter, a block body of a for loop runs in the loop's own scope
+	if (auto block = dynamic_cast<const Block*>(body)) {
+		compileHandled(block->m_stmts);
+	}
+	else compile(body);
+}
+
+void Compiler::compileHandled(const Stmts& stmts) {
+	auto start = chunk().m_code.size();
+	for (auto& stmt : stmts) {
+		compile(stmt);
+	}
+	chunk().m_handlers.push_back({ start, chunk().m_code.size(), m_scopeDepth, m_stackDepth });
+}
+
+obj_ptr<CompiledFunction> Compiler::compileFunction(const std::string& name, const std::vector<Token>& params, const Stmts& body, std::size_t scopeSize, const Captures& captures) {
+	auto enclosing = m_chunk;
+	auto enclosingDepth = m_scopeDepth;
+	auto enclosingStackDepth = m_stackDepth;
+	auto enclosingLoops = std::move(m_loops);
+
+	m_chunk = std::make_shared<Chunk>();
+	m_chunk->m_unit = m_unit;
+	m_chunk->m_captures = captures;
+	m_scopeDepth = 0;
+	m_stackDepth = 0;
+	m_loops.clear();
+
+	//! An error in the body returns nix
+	compileHandled(body);
+	emit(OpCode::NIX);
+	emit(OpCode::RETURN);
+
+	auto fn = make_obj<CompiledFunction>(name, params, m_chunk, scopeSize);
+
+	m_chunk = enclosing;
+	m_scopeDepth = enclosingDepth;
+	m_stackDepth = enclosingStackDepth;
+	m_loops = std::move(enclosingLoops);
+	return fn;
+}
+
+//! Unlike a function body, an error outside of any block ends the script, see Interpreter::interpret
+obj_ptr<CompiledFunction> Compiler::compileScript(const Stmts& stmts) {
+	m_chunk = std::make_shared<Chunk>();
+	m_chunk->m_unit = m_unit;
+	for (auto& stmt : stmts) {
+		compile(stmt);
+	}
+	emit(OpCode::NIX);
+	emit(OpCode::RETURN);
+	if (m_limit != nullptr) return nullptr;
+	return make_obj<CompiledFunction>("<script>", std::vector<Token>{}, m_chunk, 0);
+}
+
+obj_ptr<CompiledFunction> Compiler::compileScript(const Expr_ptr& expr) {
+	m_chunk = std::make_shared<Chunk>();
+	m_chunk->m_unit = m_unit;
+	compile(expr);
+	emit(OpCode::RETURN);
+	if (m_limit != nullptr) return nullptr;
+	return make_obj<CompiledFunction>("<script>", std::vector<Token>{}, m_chunk, 0);
+}
+
+// Expressions
+
+void Compiler::visit(const Binary& bin) {
+	compile(bin.m_left);
+	compile(bin.m_right);
+
+	m_line = bin.m_op.getLine();
+	switch (bin.m_op.getType()) {
+	case TokenType::PLUS: emit(OpCode::ADD); return;
+	case TokenType::MINUS: emit(OpCode::SUBTRACT); return;
+	case TokenType::PRODUCT: emit(OpCode::MULTIPLY); return;
+	case TokenType::DIVISON: emit(OpCode::DIVIDE); return;
+	case TokenType::EXPONENTATION: emit(OpCode::POWER); return;
+	case TokenType::GREATER: emit(OpCode::GREATER); return;
+	case TokenType::GT_EQUAL: emit(OpCode::GT_EQUAL); return;
+	case TokenType::LESS: emit(OpCode::LESS); return;
+	case TokenType::LT_EQUAL: emit(OpCode::LT_EQUAL); return;
+	case TokenType::EQ_EQUAL: emit(OpCode::EQUAL); return;
+	case TokenType::NOT_EQUAL: emit(OpCode::NOT_EQUAL); return;
+	default: break;
+	}
+
+	//! Same as the interpreter: an unknown operator evaluates to nix
+	emit(OpCode::POP);
+	emit(OpCode::POP);
+	emit(OpCode::NIX);
+}
+
+void Compiler::visit(const Unary& un) {
+	compile(un.m_right);
+
+	m_line = un.m_op.getLine();
+	switch (un.m_op.getType()) {
+	case TokenType::MINUS: emit(OpCode::NEGATE); break;
+	case TokenType::NOT: emit(OpCode::NOT); break;
+	default: break;
+	}
+}
+
+void Compiler::visit(const ParenGroup& group) {
+	compile(group.m_enclosedExpr);
+}
+
+void Compiler::visit(const Literal& lit) {
+	switch (lit.m_literalType) {
+	case LiteralType::NIX: emit(OpCode::NIX); break;
+	case LiteralType::TRUE: emit(OpCode::TRUE); break;
+	case LiteralType::FALSE: emit(OpCode::FALSE); break;
+	default:
+		m_line = lit.m_line;
+		emitConstant(lit.m_val);
+	}
+}
+
+void Compiler::visit(const Variable& var) {
+	m_line = var.m_name.getLine();
+	emitVariable(OpCode::GET_LOCAL, OpCode::GET_GLOBAL, var.m_resolved, var.m_name);
+}
+
+void Compiler::visit(const Logical& log) {
+	//! Logical operators always evaluate to a boolean
+	compile(log.m_left);
+
+	auto shortCircuit = (log.m_op.getType() == TokenType::OR) ? OpCode::JUMP_IF_TRUE : OpCode::JUMP_IF_FALSE;
+	auto leftJump = emitJump(shortCircuit);
+	compile(log.m_right);
+	auto rightJump = emitJump(shortCircuit);
+
+	emit(shortCircuit == OpCode::JUMP_IF_TRUE ? OpCode::FALSE : OpCode::TRUE);
+	auto endJump = emitJump(OpCode::JUMP);
+
+	patchJump(leftJump);
+	patchJump(rightJump);
+	emit(shortCircuit == OpCode::JUMP_IF_TRUE ? OpCode::TRUE : OpCode::FALSE);
+	patchJump(endJump);
+}
+
+void Compiler::visit(const Assign& expr) {
+	compile(expr.m_val);
+
+	m_line = expr.m_name.getLine();
+	if (expr.m_op.getType() == TokenType::BT_EQUAL) {
+		emitVariable(OpCode::STRICT_SET_LOCAL, OpCode::STRICT_SET_GLOBAL, expr.m_resolved, expr.m_name);
+	}
+	else {
+		emitVariable(OpCode::SET_LOCAL, OpCode::SET_GLOBAL, expr.m_resolved, expr.m_name);
+	}
+}
+
+void Compiler::visit(const Call& expr) {
+	//! A global callee is pushed by GET_GLOBAL, whose name (and cache) the call shares
+	auto var = dynamic_cast<const Variable*>(expr.m_callee);
+	bool isGlobal = var != nullptr && !var->m_resolved.m_isLocal;
+	std::size_t name = 0;
+	if (isGlobal) {
+		m_line = var->m_name.getLine();
+		name = emitVariable(OpCode::GET_LOCAL, OpCode::GET_GLOBAL, var->m_resolved, var->m_name);
+	}
+	else compile(expr.m_callee);
+	for (auto& arg : expr.m_args) {
+		compile(arg);
+	}
+
+	m_line = expr.m_paren.getLine();
+	if (expr.m_isTail) emit(isGlobal ? OpCode::TAIL_CALL_GLOBAL : OpCode::TAIL_CALL);
+	else emit(isGlobal ? OpCode::CALL_GLOBAL : OpCode::CALL);
+	emit(static_cast<std::uint8_t>(expr.m_args.size()));
+	if (isGlobal) emitShort(name);
+}
+
+void Compiler::visit(const Lambda& expr) {
+	auto fn = compileFunction("", expr.m_params, expr.m_body, expr.m_scopeSize, expr.m_captures);
+	auto index = chunk().addConstant(Callable_ptr(fn));
+	emit(OpCode::CLOSURE);
+	emitShort(index);
+}
+
+void Compiler::visit(const ListExpr& expr) {
+	for (auto& exp : expr.m_exprs) {
+		compile(exp);
+	}
+
+	m_line = expr.m_brkt.getLine();
+	if (expr.m_exprs.size() > maxShort) {
+		overLimit("Too many elements in a list literal.");
+	}
+	emit(OpCode::LIST);
+	emitShort(expr.m_exprs.size());
+}
+
+void Compiler::visit(const Index& expr) {
+	compile(expr.m_list);
+	compile(expr.m_index);
+
+	m_line = expr.m_indexOp.getLine();
+	emit(OpCode::INDEX);
+}
+
+void Compiler::visit(const RangeExpr& expr) {
+	compile(expr.m_first);
+	if (expr.m_step != nullptr) {
+		compile(expr.m_step);
+	}
+	compile(expr.m_end);
+
+	m_line = expr.m_op.getLine();
+	emit(OpCode::RANGE);
+	emit(static_cast<std::uint8_t>(expr.m_step != nullptr));
+}
+
+void Compiler::visit(const IndexAssign& expr) {
+	compile(expr.m_list);
+	compile(expr.m_index);
+	compile(expr.m_val);
+
+	m_line = expr.m_indexOp.getLine();
+	emit(OpCode::INDEX_ASSIGN);
+}
+
+void Compiler::visit(const InExpr& expr) {
+	//! Only reachable through a ranged for, which binds the name itself
+	compile(expr.m_iterable);
+
+	m_line = expr.m_inKeyword.getLine();
+	emit(OpCode::ITERABLE);
+}
+
+// Statements
+
+void Compiler::visit(const Expression& expr) {
+	compile(expr.m_expr);
+	emit(OpCode::POP);
+}
+
+void Compiler::visit(const Block& block) {
+	beginScope(block.m_scopeSize);
+	compileHandled(block.m_stmts);
+	endScope(block.m_scopeSize);
+}
+
+void Compiler::visit(const If& ifStmt) {
+	compile(ifStmt.m_condition);
+	auto thenJump = emitJump(OpCode::JUMP_IF_FALSE);
+	compile(ifStmt.m_thenBranch);
+
+	if (ifStmt.m_elseBranch != nullptr) {
+		auto elseJump = emitJump(OpCode::JUMP);
+		patchJump(thenJump);
+		compile(ifStmt.m_elseBranch);
+		patchJump(elseJump);
+	}
+	else patchJump(thenJump);
+}
+
+void Compiler::visit(const While& whilestmt) {
+	auto start = chunk().m_code.size();
+	compile(whilestmt.m_condition);
+	auto exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+
+	m_loops.push_back({ m_scopeDepth, start, false, {}, {} });
+	compile(whilestmt.m_body);
+	emitLoop(start);
+
+	patchJump(exitJump);
+	for (auto jump : m_loops.back().breakJumps) {
+		patchJump(jump);
+	}
+	m_loops.pop_back();
+}
+
+void Compiler::visit(const For& forstmt) {
+	beginScope(forstmt.m_scopeSize);	//for env
+
+	if (forstmt.m_init) {
+		compile(forstmt.m_init);
+		emit(OpCode::POP);
+	}
+
+	auto start = chunk().m_code.size();
+	compile(forstmt.m_condition);
+	auto exitJump = emitJump(OpCode::JUMP_IF_FALSE);
+
+	m_loops.push_back({ m_scopeDepth, 0, true, {}, {} });
+	compileLoopBody(forstmt.m_body);
+
+	for (auto jump : m_loops.back().continueJumps) {
+		patchJump(jump);
+	}
+	if (forstmt.m_increment) {
+		compile(forstmt.m_increment);
+		emit(OpCode::POP);
+	}
+	emitLoop(start);
+
+	patchJump(exitJump);
+	for (auto jump : m_loops.back().breakJumps) {
+		patchJump(jump);
+	}
+	m_loops.pop_back();
+
+	endScope(forstmt.m_scopeSize);
+}
+
+void Compiler::visit(const RangedFor& rforstmt) {
+	beginScope(rforstmt.m_scopeSize);	//for env
+
+	//! The iterable and the iteration counter live on the stack for the duration of the loop
+	auto inexpr = static_cast<const InExpr*>(rforstmt.m_inexpr);
+	compile(rforstmt.m_inexpr);
+	emitConstant(0.0);
+
+	auto start = chunk().m_code.size();
+	m_line = inexpr->m_inKeyword.getLine();
+	emitVariable(OpCode::FOR_ITER, OpCode::FOR_ITER, inexpr->m_resolved, inexpr->m_name);
+	emitShort(maxShort);
+	auto exitJump = chunk().m_code.size() - 2;
+
+	m_loops.push_back({ m_scopeDepth, start, false, {}, {} });
+	m_stackDepth += 2;
+	compileLoopBody(rforstmt.m_body);
+	m_stackDepth -= 2;
+	emitLoop(start);
+
+	patchJump(exitJump);
+	for (auto jump : m_loops.back().breakJumps) {
+		patchJump(jump);
+	}
+	m_loops.pop_back();
+
+	emit(OpCode::POP);
+	emit(OpCode::POP);
+	endScope(rforstmt.m_scopeSize);
+}
+
+void Compiler::visit(const Break&) {
+	if (m_loops.empty()) {
+		Proto::getInstance().error(m_line, "Cannot use 'break' outside of a loop.");
+		return;
+	}
+	auto& loop = m_loops.back();
+	emitScopeExits(loop.scopeDepth);
+	loop.breakJumps.push_back(emitJump(OpCode::JUMP));
+}
+
+void Compiler::visit(const Continue&) {
+	if (m_loops.empty()) {
+		Proto::getInstance().error(m_line, "Cannot use 'continue' outside of a loop.");
+		return;
+	}
+	auto& loop = m_loops.back();
+	emitScopeExits(loop.scopeDepth);
+	if (loop.forwardContinue) {
+		loop.continueJumps.push_back(emitJump(OpCode::JUMP));
+	}
+	else emitLoop(loop.continueTarget);
+}
+
+void Compiler::visit(const Func& func) {
+	auto fn = compileFunction(func.m_name.str(), func.m_params, func.m_body, func.m_scopeSize, func.m_captures);
+	auto index = chunk().addConstant(Callable_ptr(fn));
+
+	m_line = func.m_name.getLine();
+	emit(OpCode::CLOSURE);
+	emitShort(index);
+	emitVariable(OpCode::SET_LOCAL, OpCode::SET_GLOBAL, func.m_resolved, func.m_name);
+	emit(OpCode::POP);
+}
+
+void Compiler::visit(const Return& stmt) {
+	m_line = stmt.m_keyword.getLine();
+	if (stmt.m_val != nullptr) {
+		compile(stmt.m_val);
+	}
+	else emit(OpCode::NIX);
+	//! Still needed after a tail call, a native callee returns here
+	emit(OpCode::RETURN);
+}
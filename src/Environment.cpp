@@ -1,13 +1,18 @@
 #include "includes/Environment.hpp"
 #include "includes/Interpreter.hpp"
 
-Env_ptr Environment::getSharedPtr() {
-	return shared_from_this();
+Environment* Environment::ancestor(std::size_t dist) {
+	Environment* env = this;
+	for (std::size_t i = 0; i < dist; i++) {
+		env = env->m_parent.get();
+	}
+	return env;
 }
 
-Value& Environment::get(Token name) {
-	if (m_vars.find(name.str())!=m_vars.end()) {
-		return m_vars[name.str()];
+Value& Environment::get(const Token& name) {
+	auto var = m_vars.find(name.str());
+	if (var != m_vars.end()) {
+		return m_slots[var->second];
 	}
 
 	if (m_parent != nullptr) {
@@ -17,29 +22,27 @@ Value& Environment::get(Token name) {
 	throw RuntimeError(name, "Undefined variable '" + name.str() + "'.");
 }
 
-Value& Environment::getAt(Token name, std::size_t dist) {
-	return parentAt(dist)->get(name);
-}
-
 Env_ptr Environment::parentAt(std::size_t distance) {
-	Env_ptr env = getSharedPtr();
+	Env_ptr env(this);
 	for (std::size_t i = 0; i < distance; i++) {
 		env = env->m_parent;
 	}
 	return env;
 }
 
-bool Environment::isDefined(const std::string& name) const {
-	return (m_vars.find(name)!=m_vars.end());
-}
-
 void Environment::assign(const std::string& name, const Value& val) {
-	m_vars[name] = val;
+	auto [var, added] = m_vars.try_emplace(name, m_slots.size());
+	if (added) {
+		m_slots.push_back(Value::undefined());
+		m_versions.push_back(0);
+	}
+	assignCell(var->second, val);
 }
 
-void Environment::strictAssign(Token name, const Value& val) {
-	if (m_vars.find(name.str())!=m_vars.end()) {
-		m_vars[name.str()] = val;
+void Environment::strictAssign(const Token& name, const Value& val) {
+	auto var = m_vars.find(name.str());
+	if (var != m_vars.end()) {
+		assignCell(var->second, val);
 	}
 	else if (m_parent != nullptr) {
 		m_parent->strictAssign(name, val);
@@ -49,22 +52,121 @@ void Environment::strictAssign(Token name, const Value& val) {
 	}
 }
 
-void Environment::assignAt(const std::string& name, const Value& val, std::size_t dist) {
-	parentAt(dist)->assign(name, val);
+std::size_t Environment::findCell(const Token& name) {
+	auto var = m_vars.find(name.str());
+	if (var == m_vars.end()) {
+		throw RuntimeError(name, "Undefined variable '" + name.str() + "'.");
+	}
+	return var->second;
+}
+
+void Environment::assignCell(std::size_t cell, const Value& val) {
+	m_slots[cell] = val;
+	m_versions[cell]++;
+}
+
+Value& Environment::get(const Token& name, GlobalCache& cache) {
+	if (cache.m_cell == GlobalCache::NO_CELL) cache.m_cell = findCell(name);
+	return m_slots[cache.m_cell];
+}
+
+void Environment::assign(const Token& name, const Value& val, GlobalCache& cache) {
+	if (cache.m_cell == GlobalCache::NO_CELL) {
+		assign(name.str(), val);
+		cache.m_cell = m_vars[name.str()];
+		return;
+	}
+	assignCell(cache.m_cell, val);
+}
+
+void Environment::strictAssign(const Token& name, const Value& val, GlobalCache& cache) {
+	if (cache.m_cell == GlobalCache::NO_CELL) cache.m_cell = findCell(name);
+	assignCell(cache.m_cell, val);
+}
+
+const Value& Environment::cell(std::size_t cell) const {
+	return m_slots[cell];
+}
+
+std::uint64_t Environment::version(std::size_t cell) const {
+	return m_versions[cell];
+}
+
+//! Local scope
+
+Value& Environment::getAt(std::size_t slot, std::size_t dist, const Token& name) {
+	auto& slots = ancestor(dist)->m_slots;
+	if (slot >= slots.size()) {
+		throw RuntimeError(name, "Undefined variable '" + name.str() + "'.");
+	}
+	auto& val = Upvalue::get(slots[slot]);
+	if (val.isUndefined()) {
+		throw RuntimeError(name, "Undefined variable '" + name.str() + "'.");
+	}
+	return val;
+}
+
+void Environment::assignAt(std::size_t slot, const Value& val, std::size_t dist) {
+	auto& slots = ancestor(dist)->m_slots;
+	if (slot >= slots.size()) {
+		slots.resize(slot + 1, Value::undefined());
+	}
+	Upvalue::get(slots[slot]) = val;
+}
+
+void Environment::strictAssignAt(std::size_t slot, const Value& val, std::size_t dist, const Token& name) {
+	getAt(slot, dist, name) = val;
+}
+
+Upvalue_ptr Environment::upvalueAt(std::size_t slot, std::size_t dist) {
+	auto& slots = ancestor(dist)->m_slots;
+	if (slot >= slots.size()) {
+		slots.resize(slot + 1, Value::undefined());
+	}
+	return Upvalue::capture(slots[slot]);
+}
+
+Upvalues Environment::capture(const Captures& captures, Value* frame, const Upvalues* enclosing) {
+	Upvalues upvalues;
+	upvalues.reserve(captures.size());
+	for (auto& captured : captures) {
+		if (captured.m_isUpvalue) upvalues.push_back((*enclosing)[captured.m_slot]);
+		else if (captured.m_inFrame) upvalues.push_back(Upvalue::capture(frame[captured.m_slot]));
+		else upvalues.push_back(upvalueAt(captured.m_slot, captured.m_depth));
+	}
+	return upvalues;
 }
 
-void Environment::strictAssignAt(Token name, const Value& val, std::size_t dist) {
-	parentAt(dist)->strictAssign(name, val);
+Upvalue_ptr Upvalue::capture(Value& slot) {
+	if (slot.isUpvalue()) return slot.asRef<Upvalue>();
+
+	auto upvalue = make_obj<Upvalue>(slot);
+	slot = upvalue;
+	return upvalue;
 }
 
 //! Global scope
 
-Environment::Environment() : m_parent(nullptr) {
+Environment::Environment() : Obj(Obj::Type::ENV), m_parent(nullptr) {
 
 }
 
 //! Local scope
 
-Environment::Environment(Env_ptr env) : m_parent(env) {
+Environment::Environment(Env_ptr env, std::size_t slots) : Obj(Obj::Type::ENV), m_slots(slots, Value::undefined()), m_parent(env) {
 
-}
\ No newline at end of file
+}
+
+void Environment::trace(Tracer& tracer) {
+	for (auto& val : m_slots) {
+		if (auto obj = val.obj()) tracer.visit(obj);
+	}
+	if (m_parent) tracer.visit(m_parent.get());
+}
+
+void Environment::clearRefs() {
+	m_vars.clear();
+	m_slots.clear();
+	m_versions.clear();
+	m_parent = nullptr;
+}
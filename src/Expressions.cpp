@@ -1,3 +1,5 @@
+#include <charconv>
+
 #include "includes/Expressions.hpp"
 #include "includes/Callable.hpp"
 #include "proto.hpp"
@@ -26,16 +28,19 @@ void ParenGroup::accept(ExprVisitor* visitor) const {
 	visitor->visit(*this);
 }
 
-Literal::Literal(Token literal) : m_literalType(literal.getlType()) {
+Literal::Literal(Token literal) : m_literalType(literal.getlType()), m_line(literal.getLine()) {
 	switch (literal.getlType()) {
 	case LiteralType::NUM:
-		try {
-			m_val = std::stold(literal.str());
-		}
-		catch (const std::out_of_range&) {
+	{
+		//! The lexer only lets decimal digits, a fraction and an exponent through, all of which from_chars takes
+		auto lexeme = literal.lexeme();
+		double num = 0;
+		if (std::from_chars(lexeme.data(), lexeme.data() + lexeme.size(), num).ec == std::errc::result_out_of_range) {
 			Proto::getInstance().error(literal.getLine(), "Number out of representation range: ", literal.str());
 		}
+		m_val = num;
 		break;
+	}
 	case LiteralType::STR:
 		m_val = literal.str();
 		break;
@@ -52,6 +57,13 @@ Literal::Literal(Token literal) : m_literalType(literal.getlType()) {
 	}
 }
 
+Literal::Literal(const Value& val, std::size_t line) : m_val(val), m_line(line) {
+	if (val.isNum()) m_literalType = LiteralType::NUM;
+	else if (val.isStr()) m_literalType = LiteralType::STR;
+	else if (val.isBool()) m_literalType = val.asBool() ? LiteralType::TRUE : LiteralType::FALSE;
+	else m_literalType = LiteralType::NIX;
+}
+
 void Literal::accept(ExprVisitor* visitor) const {
 	visitor->visit(*this);
 }
@@ -0,0 +1,160 @@
+#include <chrono>
+#include <iomanip>
+#include <unordered_map>
+#include <vector>
+
+#include "includes/GC.hpp"
+
+Obj::Obj(Type type) : m_objType(type) {
+	PROTO_STATS_COUNT(static_cast<Stats::Event>(type));
+	if (m_objType != Type::STR) GC::getInstance().track(this);
+}
+
+Obj::Obj(const Obj& other) : Obj(other.m_objType) {
+
+}
+
+Obj::~Obj() {
+	if (m_tracked) GC::getInstance().untrack(this);
+}
+
+//! Takes the references between the objects being collected off their refcounts
+class InternalRefs : public Tracer {
+private:
+	bool m_full;
+	std::unordered_map<const void*, long> m_shared;
+public:
+	InternalRefs(bool full) : m_full(full) {}
+	virtual void visit(Obj* obj) override {
+		if (obj->m_tracked && (m_full || !obj->m_old)) obj->m_gcRefs--;
+	}
+	//! A shared buffer holds one reference to each of its values however many owners it has.
+	//! They're internal only once every owner is being collected, so they're taken off when
+	//! the last one traces it. An owner outside the collection keeps them as roots.
+	virtual bool visitShared(const void* buffer, long owners) override {
+		return ++m_shared[buffer] == owners;
+	}
+};
+
+class Marker : public Tracer {
+private:
+	bool m_full;
+	std::vector<Obj*>& m_worklist;
+public:
+	Marker(bool full, std::vector<Obj*>& worklist) : m_full(full), m_worklist(worklist) {}
+	virtual void visit(Obj* obj) override {
+		if (obj->m_tracked && (m_full || !obj->m_old) && !obj->m_marked) {
+			obj->m_marked = true;
+			m_worklist.push_back(obj);
+		}
+	}
+};
+
+GC& GC::getInstance() {
+	static GC gc;
+	return gc;
+}
+
+void GC::link(Obj*& head, Obj* obj) {
+	obj->m_gcPrev = nullptr;
+	obj->m_gcNext = head;
+	if (head) head->m_gcPrev = obj;
+	head = obj;
+}
+
+void GC::unlink(Obj*& head, Obj* obj) {
+	if (obj->m_gcPrev) obj->m_gcPrev->m_gcNext = obj->m_gcNext;
+	else head = obj->m_gcNext;
+	if (obj->m_gcNext) obj->m_gcNext->m_gcPrev = obj->m_gcPrev;
+}
+
+void GC::track(Obj* obj) {
+	obj->m_tracked = true;
+	link(m_youngGen, obj);
+	m_youngCount++;
+}
+
+void GC::untrack(Obj* obj) {
+	if (obj->m_old) {
+		unlink(m_oldGen, obj);
+		m_oldCount--;
+	}
+	else {
+		unlink(m_youngGen, obj);
+		m_youngCount--;
+	}
+	obj->m_tracked = false;
+}
+
+void GC::collect(bool full) {
+	auto start = std::chrono::steady_clock::now();
+	if (full) m_sinceFull = 0;
+
+	std::vector<Obj*> objs;
+	objs.reserve(m_youngCount + (full ? m_oldCount : 0));
+	for (auto obj = m_youngGen; obj != nullptr; obj = obj->m_gcNext) objs.push_back(obj);
+	if (full) {
+		for (auto obj = m_oldGen; obj != nullptr; obj = obj->m_gcNext) objs.push_back(obj);
+	}
+
+	//! Whatever is left of a refcount after this is held from outside, which makes the object a root
+	InternalRefs internal(full);
+	for (auto obj : objs) {
+		obj->m_gcRefs = obj->m_refs;
+		obj->m_marked = false;
+	}
+	for (auto obj : objs) {
+		obj->trace(internal);
+	}
+
+	std::vector<Obj*> worklist;
+	Marker marker(full, worklist);
+	for (auto obj : objs) {
+		if (obj->m_gcRefs > 0) marker.visit(obj);
+	}
+	while (!worklist.empty()) {
+		auto obj = worklist.back();
+		worklist.pop_back();
+		obj->trace(marker);
+	}
+
+	//! Hold on to the garbage while its references are cleared so nothing is freed mid-way
+	std::vector<Obj*> garbage;
+	for (auto obj : objs) {
+		if (!obj->m_marked) garbage.push_back(obj);
+	}
+	for (auto obj : garbage) obj->retain();
+	for (auto obj : garbage) obj->clearRefs();
+	for (auto obj : garbage) obj->release();
+
+	//! Survivors are promoted
+	while (m_youngGen != nullptr) {
+		auto obj = m_youngGen;
+		unlink(m_youngGen, obj);
+		obj->m_old = true;
+		link(m_oldGen, obj);
+		m_oldCount++;
+	}
+	m_youngCount = 0;
+
+	std::chrono::duration<double, std::milli> pause = std::chrono::steady_clock::now() - start;
+	m_collections++;
+	if (full) m_fullCollections++;
+	m_freed += garbage.size();
+	m_totalPause += pause.count();
+	if (pause.count() > m_maxPause) m_maxPause = pause.count();
+}
+
+void GC::setThreshold(std::size_t threshold) {
+	m_threshold = threshold;
+}
+
+void GC::printStats(std::ostream& out) const {
+	out << std::fixed << std::setprecision(3)
+		<< "[GC] collections: " << m_collections << " (" << m_fullCollections << " full)"
+		<< ", freed: " << m_freed
+		<< ", live: " << m_youngCount + m_oldCount
+		<< ", total pause: " << m_totalPause << "ms"
+		<< ", max pause: " << m_maxPause << "ms"
+		<< ", mean pause: " << (m_collections ? m_totalPause / m_collections : 0) << "ms\n";
+}
@@ -1,13 +1,16 @@
+#include <algorithm>
 #include <cmath>
 
 #include "includes/Interpreter.hpp"
 #include "includes/ForeignFuncs.hpp"
-#include "includes/ReturnThrow.hpp"
+#include "includes/GC.hpp"
+#include "includes/Kernels.hpp"
 #include "includes/Lambda.hpp"
+#include "includes/Stats.hpp"
 #include "proto.hpp"
 
 RuntimeError::RuntimeError(Token t, const std::string& err) : m_error(err), m_tok(t) {
-
+	PROTO_STATS_COUNT(Stats::Event::RUNTIME_ERRORS);
 }
 
 const char* RuntimeError::what() const noexcept {
@@ -18,35 +21,47 @@ Token RuntimeError::getToken() const {
 	return m_tok;
 }
 
-Interpreter::Interpreter() {
-	m_global = std::make_shared<Environment>();
+Interpreter::Interpreter() : m_calls{ { "<script>", 0 } } {
+	m_global = make_obj<Environment>();
 	m_env = m_global;
 	m_val = nullptr;
 
-	Value readfunc = std::make_shared<Read>();
-	Value printfunc = std::make_shared<Print>();
-	Value printlnfunc = std::make_shared<Println>();
-	Value copyfunc = std::make_shared<Copy>();
+	Value readfunc = make_obj<Read>();
+	Value printfunc = make_obj<Print>();
+	Value printlnfunc = make_obj<Println>();
+	Value copyfunc = make_obj<Copy>();
+	Value sumfunc = make_obj<Sum>();
+	Value minfunc = make_obj<Min>();
+	Value maxfunc = make_obj<Max>();
+	Value dotfunc = make_obj<Dot>();
+	Value lenfunc = make_obj<Len>();
+	Value containsfunc = make_obj<Contains>();
 	m_global->assign("read", readfunc);
 	m_global->assign("print", printfunc);
 	m_global->assign("println", printlnfunc);
 	m_global->assign("copy", copyfunc);
+	m_global->assign("sum", sumfunc);
+	m_global->assign("min", minfunc);
+	m_global->assign("max", maxfunc);
+	m_global->assign("dot", dotfunc);
+	m_global->assign("len", lenfunc);
+	m_global->assign("contains", containsfunc);
 }
 
 bool Interpreter::isNum(const Value& val) {
-	return std::holds_alternative<long double>(val);
+	return val.isNum();
 }
 
 bool Interpreter::isNix(const Value& val) {
-	return std::holds_alternative<std::nullptr_t>(val);
+	return val.isNix();
 }
 
 bool Interpreter::isStr(const Value& val) {
-	return std::holds_alternative<std::string>(val);
+	return val.isStr();
 }
 
 bool Interpreter::isBool(const Value& val) {
-	return std::holds_alternative<bool>(val);
+	return val.isBool();
 }
 
 bool Interpreter::isTrue(const Value& val) {
@@ -54,45 +69,71 @@ bool Interpreter::isTrue(const Value& val) {
 		return false;
 	}
 	if (isBool(val)) {
-		return std::get<bool>(val);
+		return val.asBool();
 	}
-	if (isNum(val) && isEqual(std::get<long double>(val), 0)) {
+	if (isNum(val) && isEqual(val.asNum(), 0)) {
 		return false;
 	}
 	return true;
 }
 
 bool Interpreter::isCallable(const Value& val) {
-	return std::holds_alternative<Callable_ptr>(val);
+	return val.isCallable();
 }
 
 bool Interpreter::isList(const Value& val) {
-	return std::holds_alternative<list_ptr>(val);
+	return val.isList();
 }
 
 bool Interpreter::isEqual(const Value& left, const Value& right) {
+	if (left.isInt() && right.isInt()) {
+		return left.asInt() == right.asInt();
+	}
 	if (isNum(left) && isNum(right)) {
-		return isEqual(std::get<long double>(left), std::get<long double>(right));
+		return isEqual(left.asNum(), right.asNum());
 	}
 	if (isList(left) && isList(right)) {
-		auto leftList = std::get<list_ptr>(left)->m_list;
-		auto leftListType = std::get<list_ptr>(left)->m_type;
+		auto leftList = left.as<list_t>();
+		auto rightList = right.as<list_t>();
 
-		auto rightList = std::get<list_ptr>(right)->m_list;
-		auto rightListType = std::get<list_ptr>(right)->m_type;
+		if (leftList->m_type != rightList->m_type) return false;
+		if (leftList->size() != rightList->size()) return false;
 
-		if (leftListType != rightListType) return false;
-		if (leftList.size() != rightList.size()) return false;
+		if (leftList == rightList) return true;
+
+		//! Comparing ranges mustn't materialize them. Two ranges are equal if they start and
+		//! step the same, a range and a list are compared element by element.
+		if (leftList->isLazy() && rightList->isLazy()) {
+			for (std::size_t i = 0; i < std::min<std::size_t>(leftList->size(), 2); i++) {
+				if (!isEqual(leftList->get(i).asNum(), rightList->get(i).asNum())) return false;
+			}
+			return true;
+		}
+		if (leftList->isLazy() || rightList->isLazy()) {
+			for (std::size_t i = 0; i < leftList->size(); i++) {
+				if (!isEqual(leftList->get(i).asNum(), rightList->get(i).asNum())) return false;
+			}
+			return true;
+		}
 
-		for (std::size_t i = 0; i < leftList.size(); i++) {
-			if (!isEqual(leftList[i], rightList[i])) return false;
+		if (leftList->m_type == list_t::Type::numList) {
+			auto leftNums = leftList->numData();
+			auto rightNums = rightList->numData();
+			for (std::size_t i = 0; i < leftList->size(); i++) {
+				if (!isEqual(leftNums[i], rightNums[i])) return false;
+			}
+			return true;
+		}
+
+		for (std::size_t i = 0; i < leftList->size(); i++) {
+			if (!isEqual(leftList->get(i), rightList->get(i))) return false;
 		}
 		return true;
 	}
 	return left == right;
 }
 
-bool Interpreter::isEqual(long double left, long double right) {
+bool Interpreter::isEqual(double left, double right) {
 	return std::fabs(left - right) < epsilon;
 }
 
@@ -100,28 +141,28 @@ std::string Interpreter::stringify(const Value& value, const char* strContainer)
 	if (isNix(value)) return "nix";
 	if (isNum(value)) {
 		std::stringstream ss;
-		ss << std::setprecision(maxPrecision) << std::get<long double>(value);
+		ss << std::setprecision(maxPrecision) << value.asNum();
 		return ss.str();
 	}
 	if (isStr(value)) {
-		return strContainer + std::get<std::string>(value) + strContainer;
+		return strContainer + value.asStr() + strContainer;
 	}
 	if (isBool(value)) {
-		return std::get<bool>(value) ? "true" : "false";
+		return value.asBool() ? "true" : "false";
 	}
 	if (isCallable(value)) {
-		return std::get<Callable_ptr>(value)->info();
+		return value.as<Callable>()->info();
 	}
 	if (isList(value)) {
-		auto list = std::get<list_ptr>(value);
-		if (list->m_list.size() > 50) {
+		auto list = value.as<list_t>();
+		if (list->size() > 50) {
 			std::string str = "[";
 			for (std::size_t i = 0; i < 10; i++) {
-				str += stringify(list->m_list[i], strContainer) + ", ";
+				str += stringify(list->get(i), strContainer) + ", ";
 			}
 			str += "..., ";
-			for (std::size_t i = list->m_list.size()-10; i < list->m_list.size(); i++) {
-				str += stringify(list->m_list[i], strContainer) + ", ";
+			for (std::size_t i = list->size()-10; i < list->size(); i++) {
+				str += stringify(list->get(i), strContainer) + ", ";
 			}
 			str.pop_back();
 			str.pop_back();
@@ -129,11 +170,11 @@ std::string Interpreter::stringify(const Value& value, const char* strContainer)
 			return str;
 		}
 		std::string str = "[";
-		for (auto& val : list->m_list) {
-			str += stringify(val, strContainer);
+		for (std::size_t i = 0; i < list->size(); i++) {
+			str += stringify(list->get(i), strContainer);
 			str += ", ";
 		}
-		if (!list->m_list.empty()) {
+		if (!list->empty()) {
 			str.pop_back();
 			str.pop_back();
 		}
@@ -143,52 +184,60 @@ std::string Interpreter::stringify(const Value& value, const char* strContainer)
 	else return "";
 }
 
-Value& Interpreter::lookUpVariable(const Expr& e, const Token& t) {
-	bool tryGlobal = false;
-	std::size_t depth = 0;
-
-	if (m_locals.find(&e) == m_locals.end()) {
-		tryGlobal = true;
+Value& Interpreter::lookUpVariable(const Resolution& resolved, GlobalCache& cache, const Token& t) {
+	if (resolved.m_inFrame) {
+		return lookUpFrame(resolved.m_slot, t);
 	}
-	else depth = m_locals.at(&e);
-	
-	if (!tryGlobal) {
-		return m_env->getAt(t, depth);
+	if (resolved.m_isUpvalue) {
+		return lookUpUpvalue(resolved.m_slot, t);
+	}
+	if (resolved.m_isLocal) {
+		return m_env->getAt(resolved.m_slot, resolved.m_depth, t);
 	}
 	else {
 		//! Either the variable is global or it doesn't exist.
-		return m_global->get(t);
+		return m_global->get(t, cache);
 	}
 }
 
-void Interpreter::verifyIndices(list_ptr list, const Value& index, Token indexOp) {
-	if (isList(index)) {
-		auto listIndex = std::get<list_ptr>(index);
-
-		if (listIndex->m_type == list_t::Type::emptyList) return;
-
-		if (listIndex->m_type != list_t::Type::numList)
-			throw RuntimeError(indexOp, "The indexing list must contain numbers.");
-
-		for (auto& i : listIndex->m_list) {
-			auto d = std::get<long double>(i);
-
-			if (!(std::fabs(d - std::lround(d)) < epsilon)) {
-				throw RuntimeError(indexOp, "Indices must be positive, non-zero integers.");
-			}
+Value& Interpreter::lookUpUpvalue(std::size_t index, const Token& t) {
+	auto& val = (*m_upvalues)[index]->m_val;
+	if (val.isUndefined()) {
+		throw RuntimeError(t, "Undefined variable '" + t.str() + "'.");
+	}
+	return val;
+}
 
-			auto num = std::lround(d);
-			if (num <= 0) throw RuntimeError(indexOp, "Indices can't be negative or zero.");
+Value& Interpreter::lookUpFrame(std::size_t slot, const Token& t) {
+	auto& val = Upvalue::get(m_stack[m_frame + slot]);
+	if (val.isUndefined()) {
+		throw RuntimeError(t, "Undefined variable '" + t.str() + "'.");
+	}
+	return val;
+}
 
-			if (static_cast<std::size_t>(num) > list->m_list.size()) throw RuntimeError(indexOp, "One or more of the indices is greater than the length of the list.");
-		}
+void Interpreter::assignVariable(const Resolution& resolved, GlobalCache& cache, const Token& t, const Value& val, bool isStrict) {
+	if (resolved.m_inFrame) {
+		if (isStrict) lookUpFrame(resolved.m_slot, t) = val;
+		else Upvalue::get(m_stack[m_frame + resolved.m_slot]) = val;
 	}
-	else if (!isNum(index)) {
-		throw RuntimeError(indexOp, "The index must be a list or a number.");
+	else if (resolved.m_isUpvalue) {
+		//! Only strict assignments reach past the function's own scopes
+		lookUpUpvalue(resolved.m_slot, t) = val;
+	}
+	else if (resolved.m_isLocal) {
+		if (isStrict) m_env->strictAssignAt(resolved.m_slot, val, resolved.m_depth, t);
+		else m_env->assignAt(resolved.m_slot, val, resolved.m_depth);
 	}
 	else {
-		auto d = std::get<long double>(index);
+		//! Global variable, or doesn't exist
+		if (isStrict) m_global->strictAssign(t, val, cache);
+		else m_global->assign(t, val, cache);
+	}
+}
 
+void Interpreter::verifyIndices(const list_t* list, const Value& index, const Token& indexOp) {
+	auto verify = [&](double d) {
 		if (!(std::fabs(d - std::lround(d)) < epsilon)) {
 			throw RuntimeError(indexOp, "Indices must be positive, non-zero integers.");
 		}
@@ -196,12 +245,148 @@ void Interpreter::verifyIndices(list_ptr list, const Value& index, Token indexOp
 		auto num = std::lround(d);
 		if (num <= 0) throw RuntimeError(indexOp, "Indices can't be negative or zero.");
 
-		if (static_cast<std::size_t>(num) > list->m_list.size()) throw RuntimeError(indexOp, "One or more of the indices is greater than the length of the list.");
-	}
-}
+		if (static_cast<std::size_t>(num) > list->size()) throw RuntimeError(indexOp, "One or more of the indices is greater than the length of the list.");
+	};
+
+	if (isList(index)) {
+		auto listIndex = index.as<list_t>();
 
-void Interpreter::resolve(const Expr& expr, std::size_t depth) {
-	m_locals[&expr] = depth;
+		if (listIndex->m_type == list_t::Type::emptyList) return;
+
+		if (listIndex->m_type != list_t::Type::numList)
+			throw RuntimeError(indexOp, "The indexing list must contain numbers.");
+
+		if (listIndex->isLazy()) {
+			//! Lazy ranges are integral and ascending, so only their ends need checking
+			verify(listIndex->get(0).asNum());
+			verify(listIndex->get(listIndex->size() - 1).asNum());
+			return;
+		}
+		for (std::size_t i = 0; i < listIndex->size(); i++) {
+			verify(listIndex->get(i).asNum());
+		}
+	}
+	else if (index.isInt()) {
+		auto num = index.asInt();
+		if (num <= 0) throw RuntimeError(indexOp, "Indices can't be negative or zero.");
+		if (static_cast<std::size_t>(num) > list->size()) throw RuntimeError(indexOp, "One or more of the indices is greater than the length of the list.");
+	}
+	else if (!isNum(index)) {
+		throw RuntimeError(indexOp, "The index must be a list or a number.");
+	}
+	else verify(index.asNum());
+}
+
+bool Interpreter::intBinary(TokenType op, std::int64_t left, std::int64_t right) {
+	switch (op) {
+	case TokenType::PLUS: m_val = Value::integer(left + right); return true;
+	case TokenType::MINUS: m_val = Value::integer(left - right); return true;
+	case TokenType::PRODUCT: m_val = Value::product(left, right); return true;
+	case TokenType::GT_EQUAL: m_val = left >= right; return true;
+	case TokenType::LT_EQUAL: m_val = left <= right; return true;
+	case TokenType::LESS: m_val = left < right; return true;
+	case TokenType::GREATER: m_val = left > right; return true;
+	case TokenType::NOT_EQUAL: m_val = left != right; return true;
+	case TokenType::EQ_EQUAL: m_val = left == right; return true;
+	default: return false;
+	}
+}
+
+Value Interpreter::listArithmetic(TokenType op, const Value& left, const Value& right, const Token& opTok) {
+	auto isNumeric = [this](const Value& val) {
+		if (isNum(val)) return true;
+		if (!isList(val)) return false;
+		auto type = val.as<list_t>()->m_type;
+		return type == list_t::Type::numList || type == list_t::Type::emptyList;
+	};
+	if (!isNumeric(left) || !isNumeric(right)) {
+		throw RuntimeError(opTok, "List operators need lists of numbers or numbers as operands.");
+	}
+
+	//! A number on either side is broadcast over the list
+	bool bothLists = isList(left) && isList(right);
+	bool scalarLeft = !isList(left);
+	auto list = (scalarLeft ? right : left).as<list_t>();
+	auto n = list->size();
+	auto nums = list->numData();
+
+	const double* other = nullptr;
+	double scalar = 0;
+	if (bothLists) {
+		if (right.as<list_t>()->size() != n) {
+			throw RuntimeError(opTok, "Both lists must have the same length.");
+		}
+		other = right.as<list_t>()->numData();
+	}
+	else scalar = scalarLeft ? left.asNum() : right.asNum();
+
+	auto& kernels = Kernels::getInstance();
+	auto arith = [&](Kernels::Op kop) {
+		std::vector<double> out(n);
+		if (bothLists) kernels.arith(kop, nums, other, out.data(), n);
+		else kernels.arith(kop, nums, scalar, scalarLeft, out.data(), n);
+		return Value(make_obj<list_t>(std::move(out)));
+	};
+	auto compare = [&](Kernels::Cmp cmp, Kernels::Cmp flipped) {
+		std::vector<std::uint8_t> mask(n);
+		if (bothLists) kernels.compare(cmp, nums, other, mask.data(), n);
+		else kernels.compare(scalarLeft ? flipped : cmp, nums, scalar, mask.data(), n);
+		return Value(make_obj<list_t>(std::vector<bool>(mask.begin(), mask.end())));
+	};
+
+	switch (op) {
+	case TokenType::PLUS: return arith(Kernels::Op::ADD);
+	case TokenType::MINUS: return arith(Kernels::Op::SUB);
+	case TokenType::PRODUCT: return arith(Kernels::Op::MUL);
+	case TokenType::DIVISON: {
+		bool divByZero = false;
+		if (isList(right)) {
+			auto divisors = right.as<list_t>();
+			for (std::size_t i = 0; i < divisors->size(); i++) divByZero |= isEqual(divisors->get(i).asNum(), 0);
+		}
+		else divByZero = isEqual(right.asNum(), 0);
+		if (divByZero) {
+			throw RuntimeError(opTok, "Cannot divide by 0!");
+		}
+		return arith(Kernels::Op::DIV);
+	}
+	case TokenType::GREATER: return compare(Kernels::Cmp::GREATER, Kernels::Cmp::LESS);
+	case TokenType::GT_EQUAL: return compare(Kernels::Cmp::GT_EQUAL, Kernels::Cmp::LT_EQUAL);
+	case TokenType::LESS: return compare(Kernels::Cmp::LESS, Kernels::Cmp::GREATER);
+	case TokenType::LT_EQUAL: return compare(Kernels::Cmp::LT_EQUAL, Kernels::Cmp::GT_EQUAL);
+	default:
+		throw RuntimeError(opTok, "Operands must be numbers.");
+	}
+}
+
+Value Interpreter::makeRange(double first, double step, double end, const Token& rangeOp) {
+	if (isEqual(step, 0)) {
+		throw RuntimeError(rangeOp, "Range step cannot be 0.");
+	}
+	if (!(first <= end)) {
+		return make_obj<list_t>(std::vector<double>{});
+	}
+	if (step < 0 || std::isinf(end)) {
+		throw RuntimeError(rangeOp, "The range never reaches its end.");
+	}
+
+	//! Below 2^53 integers are exact, so first + i * step gives the same numbers as adding the step i times
+	const double exact = 9007199254740992.0;
+	auto isIntegral = [&](double d) { return std::trunc(d) == d && std::fabs(d) < exact; };
+
+	if (isIntegral(first) && isIntegral(step) && std::fabs(end) < exact) {
+		auto count = static_cast<std::size_t>(std::floor((end - first) / step)) + 1;
+		//! The division can round across an integer boundary, settle the count against the end
+		while (count > 0 && first + static_cast<double>(count - 1) * step > end) count--;
+		while (first + static_cast<double>(count) * step <= end) count++;
+		return make_obj<list_t>(first, step, count);
+	}
+
+	std::vector<double> rangeList;
+	for (auto i = first; i <= end; i += step) {
+		rangeList.push_back(i);
+	}
+	return make_obj<list_t>(std::move(rangeList));
 }
 
 Interpreter& Interpreter::getInstance() {
@@ -210,23 +395,32 @@ Interpreter& Interpreter::getInstance() {
 }
 
 void Interpreter::visit(const Binary& bin) {
+	PROTO_STATS_VISIT("Binary");
 
 	bin.m_left->accept(this);
 	auto left = m_val;
 	bin.m_right->accept(this); //this changes m_val
 	auto right = m_val;
 
+	if (left.isInt() && right.isInt() && intBinary(bin.m_op.getType(), left.asInt(), right.asInt())) return;
+
 	bool numOperands = isNum(left) && isNum(right);
 	bool strOperands = isStr(left) && isStr(right);
 
+	//! == and != still compare whole lists
+	if ((isList(left) || isList(right)) && bin.m_op.getType() != TokenType::EQ_EQUAL && bin.m_op.getType() != TokenType::NOT_EQUAL) {
+		m_val = listArithmetic(bin.m_op.getType(), left, right, bin.m_op);
+		return;
+	}
+
 	switch (bin.m_op.getType()) {
 	case TokenType::PLUS:
 		if (numOperands) {
-			m_val = std::get<long double>(left) + std::get<long double>(right);
+			m_val = left.asNum() + right.asNum();
 			return;
 		}
 		if (strOperands) {
-			m_val = std::get<std::string>(left) + std::get<std::string>(right);
+			m_val = left.asStr() + right.asStr();
 			return;
 		}
 		throw RuntimeError(bin.m_op, "Both of the operands must be numbers or strings.");
@@ -234,28 +428,28 @@ void Interpreter::visit(const Binary& bin) {
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = std::get<long double>(left) - std::get<long double>(right);
+		m_val = left.asNum() - right.asNum();
 		return;
 	case TokenType::PRODUCT:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = std::get<long double>(left) * std::get<long double>(right);
+		m_val = left.asNum() * right.asNum();
 		return;
 	case TokenType::DIVISON:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		if (isEqual(std::get<long double>(right), 0)) {
+		if (isEqual(right.asNum(), 0)) {
 			throw RuntimeError(bin.m_op, "Cannot divide by 0!");
 		}
-		m_val = std::get<long double>(left) / std::get<long double>(right);
+		m_val = left.asNum() / right.asNum();
 		return;
 	case TokenType::EXPONENTATION:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = std::pow(std::get<long double>(left), std::get<long double>(right));
+		m_val = std::pow(left.asNum(), right.asNum());
 		return;
 
 		//comparisions
@@ -263,25 +457,25 @@ void Interpreter::visit(const Binary& bin) {
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = isEqual(std::get<long double>(left), std::get<long double>(right)) ? true : std::get<long double>(left) > std::get<long double>(right) ? true : false;
+		m_val = isEqual(left.asNum(), right.asNum()) ? true : left.asNum() > right.asNum() ? true : false;
 		return;
 	case TokenType::LT_EQUAL:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = isEqual(std::get<long double>(left), std::get<long double>(right)) ? true : std::get<long double>(left) < std::get<long double>(right) ? true : false;
+		m_val = isEqual(left.asNum(), right.asNum()) ? true : left.asNum() < right.asNum() ? true : false;
 		return;
 	case TokenType::LESS:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = isEqual(std::get<long double>(left), std::get<long double>(right)) ? false : std::get<long double>(left) < std::get<long double>(right) ? true : false;
+		m_val = isEqual(left.asNum(), right.asNum()) ? false : left.asNum() < right.asNum() ? true : false;
 		return;
 	case TokenType::GREATER:
 		if (!numOperands) {
 			throw RuntimeError(bin.m_op, "Operands must be numbers.");
 		}
-		m_val = isEqual(std::get<long double>(left), std::get<long double>(right)) ? false : std::get<long double>(left) > std::get<long double>(right) ? true : false;
+		m_val = isEqual(left.asNum(), right.asNum()) ? false : left.asNum() > right.asNum() ? true : false;
 		return;
 	case TokenType::NOT_EQUAL:
 		m_val = !isEqual(left, right);
@@ -296,6 +490,7 @@ void Interpreter::visit(const Binary& bin) {
 }
 
 void Interpreter::visit(const Unary& un) {
+	PROTO_STATS_VISIT("Unary");
 	un.m_right->accept(this);
 
 	switch (un.m_op.getType()) {
@@ -303,7 +498,7 @@ void Interpreter::visit(const Unary& un) {
 		if (!isNum(m_val)) {
 			throw RuntimeError(un.m_op, "Operand must be a number.");
 		}
-		m_val = -std::get<long double>(m_val);
+		m_val = -m_val.asNum();
 		break;
 	case TokenType::NOT:
 		m_val = !isTrue(m_val);
@@ -312,18 +507,22 @@ void Interpreter::visit(const Unary& un) {
 }
 
 void Interpreter::visit(const ParenGroup& group) {
+	PROTO_STATS_VISIT("ParenGroup");
 	group.m_enclosedExpr->accept(this);
 }
 
 void Interpreter::visit(const Literal& lit) {
+	PROTO_STATS_VISIT("Literal");
 	m_val = lit.m_val;
 }
 
 void Interpreter::visit(const Variable& var) {
-	m_val = lookUpVariable(var, var.m_name);
+	PROTO_STATS_VISIT("Variable");
+	m_val = lookUpVariable(var.m_resolved, var.m_global, var.m_name);
 }
 
 void Interpreter::visit(const Logical& log) {
+	PROTO_STATS_VISIT("Logical");
 	log.m_left->accept(this);
 
 	if (log.m_op.getType() == TokenType::OR) {
@@ -364,70 +563,87 @@ void Interpreter::visit(const Logical& log) {
 }
 
 void Interpreter::visit(const Assign& expr) {
+	PROTO_STATS_VISIT("Assign");
 	expr.m_val->accept(this);
 
 	bool isStrictAssign = expr.m_op.getType() == TokenType::BT_EQUAL;
-	bool isLazyAssign = expr.m_op.getType() == TokenType::EQUAL;
-	
-	bool tryGlobal = false;
-	std::size_t dist = 0;
-	if (m_locals.find(&expr) == m_locals.end()) {
-		tryGlobal = true;
-	}
-	else dist = m_locals.at(&expr);
+	assignVariable(expr.m_resolved, expr.m_global, expr.m_name, m_val, isStrictAssign);
+}
 
-	if (!tryGlobal) {
-		if (isLazyAssign) {
-			m_env->assignAt(expr.m_name.str(), m_val, dist);
-			return;
-		}
-		if (isStrictAssign) {
-			m_env->strictAssignAt(expr.m_name, m_val, dist);
-			return;
-		}
+void Interpreter::visit(const Call& expr) {
+	PROTO_STATS_VISIT("Call");
+	//! A global callee whose cell hasn't been assigned since it was checked here is still
+	//! that function, so it's neither looked up nor checked again
+	auto& cache = expr.m_global;
+	bool cached = cache.m_callee != nullptr && m_global->version(cache.m_cell) == cache.m_version;
+
+	Callable_ptr fn;
+	Value callee;
+	if (cached) {
+		fn = Callable_ptr(cache.m_callee);
 	}
 	else {
-		//! Global variable, or doesn't exist
-		if (isLazyAssign) {
-			m_global->assign(expr.m_name.str(), m_val);
-			return;
-		}
-		if (isStrictAssign) {
-			m_global->strictAssign(expr.m_name, m_val);
-			return;
-		}
+		expr.m_callee->accept(this);
+		callee = m_val;
 	}
-}
 
-void Interpreter::visit(const Call& expr) {
-	expr.m_callee->accept(this);
-	auto callee = m_val;
-
-	std::vector<Value> args;
+	//! The arguments become the first slots of the callee's frame if it's a Proto function
+	auto frame = m_stack.size();
 	for (auto arg : expr.m_args) {
 		arg->accept(this);
-		args.push_back(m_val);
+		m_stack.push_back(m_val);
 	}
+	auto argc = m_stack.size() - frame;
 
-	if (!isCallable(callee)) {
-		throw RuntimeError(expr.m_paren, "Provided object is not callable.");
-	}
+	auto proto = cached ? cache.m_proto : nullptr;
+	if (!cached) {
+		if (!isCallable(callee)) {
+			throw RuntimeError(expr.m_paren, "Provided object is not callable.");
+		}
+
+		fn = callee.asRef<Callable>();
+		if (static_cast<std::size_t>(fn->arity()) != argc) {
+			std::string err = "Expected " + std::to_string(fn->arity()) + " argument(s) but got " + std::to_string(argc) + " argument(s).";
+
+			throw RuntimeError(expr.m_paren, err);
+		}
+		proto = dynamic_cast<ProtoFunction*>(fn.get());
 
-	auto fn = std::get<Callable_ptr>(callee);
-	if (fn->arity() != args.size()) {
-		std::string err = "Expected " + std::to_string(fn->arity()) + " argument(s) but got " + std::to_string(args.size()) + " argument(s).";
+		//! Only if the cell still holds the callee, the arguments could have reassigned it
+		auto var = dynamic_cast<const Variable*>(expr.m_callee);
+		if (var && !var->m_resolved.m_isLocal && var->m_global.m_cell != GlobalCache::NO_CELL && m_global->cell(var->m_global.m_cell).obj() == fn.get()) {
+			cache.m_cell = var->m_global.m_cell;
+			cache.m_version = m_global->version(cache.m_cell);
+			cache.m_callee = fn.get();
+			cache.m_proto = proto;
+		}
+	}
 
-		throw RuntimeError(expr.m_paren, err);
+	if (proto) {
+		//! The caller picks up the callee and runs it in its own frame, see ProtoFunction::callInPlace
+		if (expr.m_isTail) m_tailCall = obj_ptr<ProtoFunction>(proto);
+		else m_val = proto->callInPlace(frame);
+		return;
 	}
 
-	m_val = fn->call(args);
+	Values args(m_stack.begin() + frame, m_stack.end());
+	m_stack.resize(frame);
+	try {
+		m_val = fn->call(args);
+	}
+	catch (const NativeError& err) {
+		throw RuntimeError(expr.m_paren, err.what());
+	}
 }
 
 void Interpreter::visit(const Lambda& expr) {
-	m_val = std::make_shared<ProtoFunction>("", expr.m_params, expr.m_body);
+	PROTO_STATS_VISIT("Lambda");
+	auto upvalues = m_env->capture(expr.m_captures, m_stack.data() + m_frame, m_upvalues);
+	m_val = make_obj<ProtoFunction>("", expr.m_params, expr.m_body, expr.m_scopeSize, std::move(upvalues), expr.m_unit->shared_from_this());
 }
 
 void Interpreter::visit(const ListExpr& expr) {
+	PROTO_STATS_VISIT("ListExpr");
 	Values values;
 	std::size_t type = 999; //999 == empty list
 	bool first = true;
@@ -435,123 +651,111 @@ void Interpreter::visit(const ListExpr& expr) {
 		exp->accept(this);
 		values.push_back(m_val);
 		if (first) {
-			type = m_val.index();
+			type = static_cast<std::size_t>(m_val.type());
 			first = false;
 		}
-		if (type != m_val.index()) {
+		if (type != static_cast<std::size_t>(m_val.type())) {
 			throw RuntimeError(expr.m_brkt, "Lists are homogenous and can't contain different types.");
 		}
 	}
-	m_val = std::make_shared<list_t>(values, static_cast<list_t::Type>(type));
+	m_val = make_obj<list_t>(std::move(values), static_cast<list_t::Type>(type));
 }
 
 void Interpreter::visit(const Index& expr) {
+	PROTO_STATS_VISIT("Index");
 	expr.m_list->accept(this);
 	
 	if (!isList(m_val)) {
 		throw RuntimeError(expr.m_indexOp, "The index operator can only be used on lists.");
 	}
 
-	auto list = std::get<list_ptr>(m_val);
+	auto list = m_val.asRef<list_t>();
 
 	expr.m_index->accept(this);
 	auto index = m_val;
 
-	verifyIndices(list, index, expr.m_indexOp);
+	verifyIndices(list.get(), index, expr.m_indexOp);
 
 	if (isList(index)) {
-		auto listIndex = std::get<list_ptr>(index);
-		Values val;
-		for (auto& i : listIndex->m_list) {
-			auto in = std::lround(std::get<long double>(i));
-			val.push_back(list->m_list[in-1]);
-		}
-		m_val = std::make_shared<list_t>(val, list->m_type);
+		m_val = list->gather(*index.as<list_t>());
 	}
 	else if(isNum(index)) {
-		auto in = std::lround(std::get<long double>(index));
-		m_val = list->m_list[in-1];
+		m_val = list->get(toIndex(index) - 1);
 	}
 }
 
 void Interpreter::visit(const RangeExpr& expr) {
+	PROTO_STATS_VISIT("RangeExpr");
 	expr.m_first->accept(this);
 	if (!isNum(m_val)) {
 		throw RuntimeError(expr.m_op, "Ranges can only contain numeric descriptors.");
 	}
-	long double first = std::get<long double>(m_val);
+	double first = m_val.asNum();
 
-	long double step = 1;
+	double step = 1;
 	if (expr.m_step != nullptr) {
 		expr.m_step->accept(this);
 		if (!isNum(m_val)) {
 			throw RuntimeError(expr.m_op, "Ranges can only contain numeric descriptors.");
 		}
-		step = std::get<long double>(m_val);
-		if (isEqual(step, 0)) {
-			throw RuntimeError(expr.m_op, "Range step cannot be 0.");
-		}
+		step = m_val.asNum();
 	}
 
 	expr.m_end->accept(this);
 	if (!isNum(m_val)) {
 		throw RuntimeError(expr.m_op, "Ranges can only contain numeric descriptors.");
 	}
-	long double end = std::get<long double>(m_val);
-
-	Values rangeList;
+	double end = m_val.asNum();
 
-	for (auto i = first; i <= end; i += step) {
-		rangeList.push_back(i);
-	}
-
-	m_val = std::make_shared<list_t>(rangeList, list_t::Type::numList);
+	m_val = makeRange(first, step, end, expr.m_op);
 }
 
 void Interpreter::visit(const IndexAssign& expr) {
+	PROTO_STATS_VISIT("IndexAssign");
 	expr.m_list->accept(this);
 
 	if (!isList(m_val)) {
 		throw RuntimeError(expr.m_indexOp, "The index operator can only be used on lists.");
 	}
 
-	auto list = std::get<list_ptr>(m_val);
+	auto list = m_val.asRef<list_t>();
 
 	expr.m_index->accept(this);
 	auto index = m_val;
 	
-	verifyIndices(list, index, expr.m_indexOp);
+	verifyIndices(list.get(), index, expr.m_indexOp);
 
 	expr.m_val->accept(this);
 	auto value = m_val;
 	if (isList(index)) {
-		auto indexList = std::get<list_ptr>(index);
+		auto indexList = index.as<list_t>();
 		if (!isList(value)) throw RuntimeError(expr.m_op, "The value must be a list.");
-		auto valueList = std::get<list_ptr>(value);
+		auto valueList = value.as<list_t>();
 
-		if (indexList->m_list.size() != valueList->m_list.size()) {
+		if (indexList->size() != valueList->size()) {
 			throw RuntimeError(expr.m_op, "The value list's length must be equal to the number of indices accessed.");
 		}
-		if (indexList->m_type != valueList->m_type) {
+		if (!valueList->empty() && list->m_type != valueList->m_type) {
 			throw RuntimeError(expr.m_op, "Type mismatch for list assignment.");
 		}
 
-		for (std::size_t i = 0; i < indexList->m_list.size(); i++) {
-			auto index = std::lround(std::get<long double>(indexList->m_list[i]));
-			list->m_list.at(index - 1) = valueList->m_list.at(i);
+		for (std::size_t i = 0; i < indexList->size(); i++) {
+			auto index = toIndex(indexList->get(i));
+			list->set(index - 1, valueList->get(i));
 		}
 	}
 	else if(isNum(index)) {
-		auto i = std::lround(std::get<long double>(index));
+		auto i = toIndex(index);
 
-		if (value.index() != list->m_list[1].index()) throw RuntimeError(expr.m_indexOp, "Type mismatch for list assignment.");
+		if (static_cast<std::size_t>(value.type()) != static_cast<std::size_t>(list->m_type)) throw RuntimeError(expr.m_indexOp, "Type mismatch for list assignment.");
 
-		list->m_list.at(i - 1) = value;
+		list->set(i - 1, value);
 	}
 
 }
 
 void Interpreter::visit(const InExpr& expr) {
+	PROTO_STATS_VISIT("InExpr");
 	//! Resolver deals with the case where this is outside a for loop
 	expr.m_iterable->accept(this);
 
@@ -561,14 +765,17 @@ void Interpreter::visit(const InExpr& expr) {
 }
 
 void Interpreter::visit(const Expression& expr) {
+	PROTO_STATS_VISIT("Expression");
 	expr.m_expr->accept(this);
 }
 
 void Interpreter::visit(const Block& block) {
-	executeBlock(block.m_stmts, std::make_shared<Environment>(m_env));
+	PROTO_STATS_VISIT("Block");
+	executeBlock(block.m_stmts, block.m_scopeSize ? make_obj<Environment>(m_env, block.m_scopeSize) : m_env);
 }
 
 void Interpreter::visit(const If& ifStmt) {
+	PROTO_STATS_VISIT("If");
 
 	ifStmt.m_condition->accept(this);
 	if (isTrue(m_val)) {
@@ -581,132 +788,133 @@ void Interpreter::visit(const If& ifStmt) {
 }
 
 void Interpreter::visit(const While& whilestmt) {
+	PROTO_STATS_VISIT("While");
 	whilestmt.m_condition->accept(this);
-	try{
-		while (isTrue(m_val)) {
-			try {
-				execute(whilestmt.m_body);
-			}
-			catch (const ContinueThrow&){}
-			whilestmt.m_condition->accept(this);
-		}
-	}
-	catch (const BreakThrow&) {
-		//we broke out of the loop
+	while (isTrue(m_val)) {
+		execute(whilestmt.m_body);
+		if (exitsLoop()) break;
+		whilestmt.m_condition->accept(this);
 	}
 }
 
 void Interpreter::visit(const For& forstmt) {
+	PROTO_STATS_VISIT("For");
 	Env_ptr parent = m_env;
-	m_env = std::make_shared<Environment>(m_env); //for env
+	if (forstmt.m_scopeSize) m_env = make_obj<Environment>(m_env, forstmt.m_scopeSize); //for env
 
 	if (forstmt.m_init) {
 		forstmt.m_init->accept(this);
 	}
 	
 	forstmt.m_condition->accept(this);
-	try {
-		while (isTrue(m_val)) {
-			try {
-				if (auto block = std::dynamic_pointer_cast<Block>(forstmt.m_body)) {
-					executeBlock(block->m_stmts, m_env);
-				}
-				else execute(forstmt.m_body);
-			}
-			catch (const ContinueThrow&) {}
-			if (forstmt.m_increment) {
-				forstmt.m_increment->accept(this);
-			}
-			forstmt.m_condition->accept(this);
+	while (isTrue(m_val)) {
+		if (auto block = dynamic_cast<const Block*>(forstmt.m_body)) {
+			executeBlock(block->m_stmts, m_env);
 		}
-	}
-	catch (const BreakThrow&) {
-		//we broke out of the loop
+		else execute(forstmt.m_body);
+		if (exitsLoop()) break;
+
+		if (forstmt.m_increment) {
+			forstmt.m_increment->accept(this);
+		}
+		forstmt.m_condition->accept(this);
 	}
 
 	m_env = parent;
 }
 
 void Interpreter::visit(const RangedFor& rforstmt) {
+	PROTO_STATS_VISIT("RangedFor");
 	Env_ptr parent = m_env;
-	m_env = std::make_shared<Environment>(m_env); //for env
+	if (rforstmt.m_scopeSize) m_env = make_obj<Environment>(m_env, rforstmt.m_scopeSize); //for env
 	
 	rforstmt.m_inexpr->accept(this);
 
-	auto iterable = std::get<list_ptr>(m_val);
-
-	std::size_t dist = 0;
-	dist = m_locals.at(rforstmt.m_inexpr.get());
+	auto iterable = m_val.asRef<list_t>();
 
-	std::string name = std::static_pointer_cast<InExpr>(rforstmt.m_inexpr)->m_name.str();
+	auto& resolved = static_cast<const InExpr*>(rforstmt.m_inexpr)->m_resolved;
 
-	try {
-		for (std::size_t i = 0;i < iterable->m_list.size();i++) {
-			auto element = iterable->m_list[i];
-			m_env->assignAt(name, element, dist);
-			try {
-				if (auto block = std::dynamic_pointer_cast<Block>(rforstmt.m_body)) {
-					executeBlock(block->m_stmts, m_env);
-				}
-				else execute(rforstmt.m_body);
-			}
-			catch (const ContinueThrow&) {}
+	for (std::size_t i = 0;i < iterable->size();i++) {
+		m_env->assignAt(resolved.m_slot, iterable->get(i), resolved.m_depth);
+		if (auto block = dynamic_cast<const Block*>(rforstmt.m_body)) {
+			executeBlock(block->m_stmts, m_env);
 		}
-	}
-	catch (const BreakThrow&) {
-		//we broke out of the loop
+		else execute(rforstmt.m_body);
+		if (exitsLoop()) break;
 	}
 
 	m_env = parent;
 }
 
 void Interpreter::visit(const Break& breakstmt) {
-	throw BreakThrow();
+	PROTO_STATS_VISIT("Break");
+	m_completion = Completion::BREAK;
 }
 
 void Interpreter::visit(const Continue& contstmt) {
-	throw ContinueThrow();
+	PROTO_STATS_VISIT("Continue");
+	m_completion = Completion::CONTINUE;
 }
 
 void Interpreter::visit(const Func& func) {
-	auto fn = std::make_shared<ProtoFunction>(func.m_name, func.m_params, func.m_body);
-	m_env->assign(func.m_name.str(), fn);
+	PROTO_STATS_VISIT("Func");
+	auto upvalues = m_env->capture(func.m_captures, m_stack.data() + m_frame, m_upvalues);
+	auto fn = make_obj<ProtoFunction>(func.m_name, func.m_params, func.m_body, func.m_scopeSize, std::move(upvalues), func.m_unit->shared_from_this());
+	GlobalCache cache;
+	assignVariable(func.m_resolved, cache, func.m_name, fn, false);
 }
 
 void Interpreter::visit(const Return& stmt) {
+	PROTO_STATS_VISIT("Return");
 	if (stmt.m_val != nullptr) {
 		stmt.m_val->accept(this);
 	}
 	else m_val = nullptr;
-	throw ReturnThrow(m_val);
+	//! m_val holds the return value until the call picks it up
+	m_completion = Completion::RETURN;
 }
 
-void Interpreter::execute(Stmt_ptr stmt) {
+Interpreter::Completion Interpreter::execute(Stmt_ptr stmt) {
+	GC::getInstance().maybeCollect();
+	m_calls.back().m_line = stmt->m_line;
+	auto& profiler = Profiler::getInstance();
+	if (profiler.sampleDue()) profiler.sample(m_calls);
 	stmt->accept(this);
+	return m_completion;
+}
+
+bool Interpreter::exitsLoop() {
+	switch (m_completion) {
+	case Completion::BREAK:
+		m_completion = Completion::NORMAL;
+		return true;
+	case Completion::RETURN:
+		//! Keep unwinding until the call is reached
+		return true;
+	default:
+		m_completion = Completion::NORMAL;
+		return false;
+	}
 }
 
-void Interpreter::executeBlock(Stmts stmts, Env_ptr env) {
+void Interpreter::executeBlock(const Stmts& stmts, Env_ptr env) {
 	Env_ptr parent = m_env;
+	auto stackSize = m_stack.size();	//arguments of a call that failed are left behind
 	
 	try {
 		m_env = env;
 
 		for (auto stmt : stmts) {
-			execute(stmt);
+			if (execute(stmt) != Completion::NORMAL) break;
 		}
 
 		m_env = parent;
 	}
 	catch (const RuntimeError& err) {
 		m_env = parent;
+		m_stack.resize(stackSize);
 		Proto::getInstance().runtimeError(err);
 	}
-	catch (const ReturnThrow& rtrn) {
-		//! Make sure the environment is reset before undwinding all the 
-		//! way back to the call...
-		m_env = parent;
-		throw rtrn;
-	}
 }
 
 void Interpreter::interpret(const Stmts& stmts) {
@@ -716,6 +924,8 @@ void Interpreter::interpret(const Stmts& stmts) {
 		}
 	}
 	catch (const RuntimeError& err) {
+		m_calls.resize(1);
+		m_stack.clear();
 		Proto::getInstance().runtimeError(err);
 	}
 }
@@ -723,12 +933,13 @@ void Interpreter::interpret(const Stmts& stmts) {
 std::string Interpreter::interpret(Expr_ptr expr) {
 	try {
 		expr->accept(this);
-		if (!(std::dynamic_pointer_cast<Call>(expr) && isNix(m_val))) {
+		if (!(dynamic_cast<const Call*>(expr) && isNix(m_val))) {
 			return stringify(m_val, "\"");
 		}
 		else return "";
 	}
 	catch (const RuntimeError& err) {
+		m_stack.clear();
 		Proto::getInstance().runtimeError(err);
 		return "";
 	}
@@ -0,0 +1,486 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "includes/Kernels.hpp"
+#include "includes/Expressions.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PROTO_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+//! MSVC allows intrinsics of any instruction set without extra flags
+#define PROTO_TARGET_SSE2
+#define PROTO_TARGET_AVX2
+#else
+//! Only the kernels themselves are compiled for the wider instruction sets, the rest of the
+//! binary keeps running on any x86 CPU
+#define PROTO_TARGET_SSE2 __attribute__((target("sse2")))
+#define PROTO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+using Op = Kernels::Op;
+using Cmp = Kernels::Cmp;
+using ArithFn = void (*)(const double*, const double*, double*, std::size_t);
+using CompareFn = void (*)(const double*, const double*, std::uint8_t*, std::size_t);
+
+//! Scalar kernels. These also finish the tails the vector kernels leave over.
+
+template <Op op>
+static inline double apply(double a, double b) {
+	if constexpr (op == Op::ADD) return a + b;
+	else if constexpr (op == Op::SUB) return a - b;
+	else if constexpr (op == Op::MUL) return a * b;
+	else return a / b;
+}
+
+template <Cmp cmp>
+static inline bool test(double a, double b) {
+	bool near = std::fabs(a - b) < epsilon;
+	if constexpr (cmp == Cmp::GREATER) return !near && a > b;
+	else if constexpr (cmp == Cmp::GT_EQUAL) return near || a > b;
+	else if constexpr (cmp == Cmp::LESS) return !near && a < b;
+	else return near || a < b;
+}
+
+//! With broadcast set, b points to a single scalar. With reversed set, it is the left operand.
+template <Op op, bool broadcast, bool reversed>
+struct ScalarArith {
+	static void run(const double* a, const double* b, double* out, std::size_t n) {
+		for (std::size_t i = 0; i < n; i++) {
+			double y = broadcast ? b[0] : b[i];
+			out[i] = reversed ? apply<op>(y, a[i]) : apply<op>(a[i], y);
+		}
+	}
+};
+
+template <Cmp cmp, bool broadcast>
+struct ScalarCompare {
+	static void run(const double* a, const double* b, std::uint8_t* out, std::size_t n) {
+		for (std::size_t i = 0; i < n; i++) {
+			out[i] = test<cmp>(a[i], broadcast ? b[0] : b[i]);
+		}
+	}
+};
+
+//! The reductions keep four partial results, lane j seeing elements j, j+4, j+8, ...
+//! in order, and combine them the same way on every instruction set.
+
+static double sumLanes(const double* lanes, const double* tail, std::size_t n) {
+	double res = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	for (std::size_t i = 0; i < n; i++) res += tail[i];
+	return res;
+}
+
+static double dotLanes(const double* lanes, const double* a, const double* b, std::size_t n) {
+	double res = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	for (std::size_t i = 0; i < n; i++) res += a[i] * b[i];
+	return res;
+}
+
+static double minLanes(const double* lanes, const double* tail, std::size_t n) {
+	double left = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+	double right = lanes[2] < lanes[3] ? lanes[2] : lanes[3];
+	double res = left < right ? left : right;
+	for (std::size_t i = 0; i < n; i++) res = tail[i] < res ? tail[i] : res;
+	return res;
+}
+
+static double maxLanes(const double* lanes, const double* tail, std::size_t n) {
+	double left = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+	double right = lanes[2] > lanes[3] ? lanes[2] : lanes[3];
+	double res = left > right ? left : right;
+	for (std::size_t i = 0; i < n; i++) res = tail[i] > res ? tail[i] : res;
+	return res;
+}
+
+static double sumScalar(const double* a, std::size_t n) {
+	double lanes[4] = { 0, 0, 0, 0 };
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (std::size_t j = 0; j < 4; j++) lanes[j] += a[i + j];
+	}
+	return sumLanes(lanes, a + i, n - i);
+}
+
+static double dotScalar(const double* a, const double* b, std::size_t n) {
+	double lanes[4] = { 0, 0, 0, 0 };
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (std::size_t j = 0; j < 4; j++) lanes[j] += a[i + j] * b[i + j];
+	}
+	return dotLanes(lanes, a + i, b + i, n - i);
+}
+
+static double minScalar(const double* a, std::size_t n) {
+	double lanes[4] = { a[0], a[0], a[0], a[0] };
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (std::size_t j = 0; j < 4; j++) lanes[j] = a[i + j] < lanes[j] ? a[i + j] : lanes[j];
+	}
+	return minLanes(lanes, a + i, n - i);
+}
+
+static double maxScalar(const double* a, std::size_t n) {
+	double lanes[4] = { a[0], a[0], a[0], a[0] };
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		for (std::size_t j = 0; j < 4; j++) lanes[j] = a[i + j] > lanes[j] ? a[i + j] : lanes[j];
+	}
+	return maxLanes(lanes, a + i, n - i);
+}
+
+#ifdef PROTO_X86
+
+//! SSE2 kernels, two doubles per register
+
+template <Op op>
+PROTO_TARGET_SSE2 static inline __m128d apply128(__m128d a, __m128d b) {
+	if constexpr (op == Op::ADD) return _mm_add_pd(a, b);
+	else if constexpr (op == Op::SUB) return _mm_sub_pd(a, b);
+	else if constexpr (op == Op::MUL) return _mm_mul_pd(a, b);
+	else return _mm_div_pd(a, b);
+}
+
+template <Cmp cmp>
+PROTO_TARGET_SSE2 static inline int test128(__m128d a, __m128d b) {
+	__m128d dist = _mm_andnot_pd(_mm_set1_pd(-0.0), _mm_sub_pd(a, b));
+	__m128d near = _mm_cmplt_pd(dist, _mm_set1_pd(epsilon));
+	__m128d res;
+	if constexpr (cmp == Cmp::GREATER) res = _mm_andnot_pd(near, _mm_cmpgt_pd(a, b));
+	else if constexpr (cmp == Cmp::GT_EQUAL) res = _mm_or_pd(near, _mm_cmpgt_pd(a, b));
+	else if constexpr (cmp == Cmp::LESS) res = _mm_andnot_pd(near, _mm_cmplt_pd(a, b));
+	else res = _mm_or_pd(near, _mm_cmplt_pd(a, b));
+	return _mm_movemask_pd(res);
+}
+
+template <Op op, bool broadcast, bool reversed>
+struct Sse2Arith {
+	PROTO_TARGET_SSE2 static void run(const double* a, const double* b, double* out, std::size_t n) {
+		__m128d scalar = broadcast ? _mm_set1_pd(b[0]) : _mm_setzero_pd();
+		std::size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			__m128d x = _mm_loadu_pd(a + i);
+			__m128d y = broadcast ? scalar : _mm_loadu_pd(b + i);
+			_mm_storeu_pd(out + i, reversed ? apply128<op>(y, x) : apply128<op>(x, y));
+		}
+		ScalarArith<op, broadcast, reversed>::run(a + i, broadcast ? b : b + i, out + i, n - i);
+	}
+};
+
+template <Cmp cmp, bool broadcast>
+struct Sse2Compare {
+	PROTO_TARGET_SSE2 static void run(const double* a, const double* b, std::uint8_t* out, std::size_t n) {
+		__m128d scalar = broadcast ? _mm_set1_pd(b[0]) : _mm_setzero_pd();
+		std::size_t i = 0;
+		for (; i + 2 <= n; i += 2) {
+			int mask = test128<cmp>(_mm_loadu_pd(a + i), broadcast ? scalar : _mm_loadu_pd(b + i));
+			out[i] = mask & 1;
+			out[i + 1] = (mask >> 1) & 1;
+		}
+		ScalarCompare<cmp, broadcast>::run(a + i, broadcast ? b : b + i, out + i, n - i);
+	}
+};
+
+PROTO_TARGET_SSE2 static double sumSse2(const double* a, std::size_t n) {
+	__m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		low = _mm_add_pd(low, _mm_loadu_pd(a + i));
+		high = _mm_add_pd(high, _mm_loadu_pd(a + i + 2));
+	}
+	double lanes[4];
+	_mm_storeu_pd(lanes, low);
+	_mm_storeu_pd(lanes + 2, high);
+	return sumLanes(lanes, a + i, n - i);
+}
+
+PROTO_TARGET_SSE2 static double dotSse2(const double* a, const double* b, std::size_t n) {
+	__m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		low = _mm_add_pd(low, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+		high = _mm_add_pd(high, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+	}
+	double lanes[4];
+	_mm_storeu_pd(lanes, low);
+	_mm_storeu_pd(lanes + 2, high);
+	return dotLanes(lanes, a + i, b + i, n - i);
+}
+
+PROTO_TARGET_SSE2 static double minSse2(const double* a, std::size_t n) {
+	__m128d low = _mm_set1_pd(a[0]), high = low;
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		low = _mm_min_pd(_mm_loadu_pd(a + i), low);
+		high = _mm_min_pd(_mm_loadu_pd(a + i + 2), high);
+	}
+	double lanes[4];
+	_mm_storeu_pd(lanes, low);
+	_mm_storeu_pd(lanes + 2, high);
+	return minLanes(lanes, a + i, n - i);
+}
+
+PROTO_TARGET_SSE2 static double maxSse2(const double* a, std::size_t n) {
+	__m128d low = _mm_set1_pd(a[0]), high = low;
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		low = _mm_max_pd(_mm_loadu_pd(a + i), low);
+		high = _mm_max_pd(_mm_loadu_pd(a + i + 2), high);
+	}
+	double lanes[4];
+	_mm_storeu_pd(lanes, low);
+	_mm_storeu_pd(lanes + 2, high);
+	return maxLanes(lanes, a + i, n - i);
+}
+
+//! AVX2 kernels, four doubles per register
+
+template <Op op>
+PROTO_TARGET_AVX2 static inline __m256d apply256(__m256d a, __m256d b) {
+	if constexpr (op == Op::ADD) return _mm256_add_pd(a, b);
+	else if constexpr (op == Op::SUB) return _mm256_sub_pd(a, b);
+	else if constexpr (op == Op::MUL) return _mm256_mul_pd(a, b);
+	else return _mm256_div_pd(a, b);
+}
+
+template <Cmp cmp>
+PROTO_TARGET_AVX2 static inline int test256(__m256d a, __m256d b) {
+	__m256d dist = _mm256_andnot_pd(_mm256_set1_pd(-0.0), _mm256_sub_pd(a, b));
+	__m256d near = _mm256_cmp_pd(dist, _mm256_set1_pd(epsilon), _CMP_LT_OQ);
+	__m256d res;
+	if constexpr (cmp == Cmp::GREATER) res = _mm256_andnot_pd(near, _mm256_cmp_pd(a, b, _CMP_GT_OQ));
+	else if constexpr (cmp == Cmp::GT_EQUAL) res = _mm256_or_pd(near, _mm256_cmp_pd(a, b, _CMP_GT_OQ));
+	else if constexpr (cmp == Cmp::LESS) res = _mm256_andnot_pd(near, _mm256_cmp_pd(a, b, _CMP_LT_OQ));
+	else res = _mm256_or_pd(near, _mm256_cmp_pd(a, b, _CMP_LT_OQ));
+	return _mm256_movemask_pd(res);
+}
+
+template <Op op, bool broadcast, bool reversed>
+struct Avx2Arith {
+	PROTO_TARGET_AVX2 static void run(const double* a, const double* b, double* out, std::size_t n) {
+		__m256d scalar = broadcast ? _mm256_set1_pd(b[0]) : _mm256_setzero_pd();
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			__m256d x = _mm256_loadu_pd(a + i);
+			__m256d y = broadcast ? scalar : _mm256_loadu_pd(b + i);
+			_mm256_storeu_pd(out + i, reversed ? apply256<op>(y, x) : apply256<op>(x, y));
+		}
+		ScalarArith<op, broadcast, reversed>::run(a + i, broadcast ? b : b + i, out + i, n - i);
+	}
+};
+
+template <Cmp cmp, bool broadcast>
+struct Avx2Compare {
+	PROTO_TARGET_AVX2 static void run(const double* a, const double* b, std::uint8_t* out, std::size_t n) {
+		__m256d scalar = broadcast ? _mm256_set1_pd(b[0]) : _mm256_setzero_pd();
+		std::size_t i = 0;
+		for (; i + 4 <= n; i += 4) {
+			int mask = test256<cmp>(_mm256_loadu_pd(a + i), broadcast ? scalar : _mm256_loadu_pd(b + i));
+			for (std::size_t j = 0; j < 4; j++) out[i + j] = (mask >> j) & 1;
+		}
+		ScalarCompare<cmp, broadcast>::run(a + i, broadcast ? b : b + i, out + i, n - i);
+	}
+};
+
+PROTO_TARGET_AVX2 static double sumAvx2(const double* a, std::size_t n) {
+	__m256d acc = _mm256_setzero_pd();
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	return sumLanes(lanes, a + i, n - i);
+}
+
+PROTO_TARGET_AVX2 static double dotAvx2(const double* a, const double* b, std::size_t n) {
+	__m256d acc = _mm256_setzero_pd();
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	return dotLanes(lanes, a + i, b + i, n - i);
+}
+
+PROTO_TARGET_AVX2 static double minAvx2(const double* a, std::size_t n) {
+	__m256d acc = _mm256_set1_pd(a[0]);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		acc = _mm256_min_pd(_mm256_loadu_pd(a + i), acc);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	return minLanes(lanes, a + i, n - i);
+}
+
+PROTO_TARGET_AVX2 static double maxAvx2(const double* a, std::size_t n) {
+	__m256d acc = _mm256_set1_pd(a[0]);
+	std::size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		acc = _mm256_max_pd(_mm256_loadu_pd(a + i), acc);
+	}
+	double lanes[4];
+	_mm256_storeu_pd(lanes, acc);
+	return maxLanes(lanes, a + i, n - i);
+}
+
+static Kernels::Isa detectIsa() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool sse2 = info[3] & (1 << 26);
+	bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+	bool avx2 = false;
+	if (osAvx && maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		avx2 = info[1] & (1 << 5);
+	}
+#else
+	__builtin_cpu_init();
+	bool sse2 = __builtin_cpu_supports("sse2");
+	bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (avx2) return Kernels::Isa::AVX2;
+	if (sse2) return Kernels::Isa::SSE2;
+	return Kernels::Isa::SCALAR;
+}
+
+#else
+
+static Kernels::Isa detectIsa() {
+	return Kernels::Isa::SCALAR;
+}
+
+#endif
+
+//! Picks the instantiation for an operation. Impl is one of the *Arith templates above.
+template <template <Op, bool, bool> class Impl, bool broadcast, bool reversed>
+static ArithFn pickArith(Op op) {
+	switch (op) {
+	case Op::ADD: return &Impl<Op::ADD, broadcast, reversed>::run;
+	case Op::SUB: return &Impl<Op::SUB, broadcast, reversed>::run;
+	case Op::MUL: return &Impl<Op::MUL, broadcast, reversed>::run;
+	default: return &Impl<Op::DIV, broadcast, reversed>::run;
+	}
+}
+
+template <template <Op, bool, bool> class Impl>
+static ArithFn pickArith(Op op, bool broadcast, bool reversed) {
+	if (!broadcast) return pickArith<Impl, false, false>(op);
+	return reversed ? pickArith<Impl, true, true>(op) : pickArith<Impl, true, false>(op);
+}
+
+template <template <Cmp, bool> class Impl, bool broadcast>
+static CompareFn pickCompare(Cmp cmp) {
+	switch (cmp) {
+	case Cmp::GREATER: return &Impl<Cmp::GREATER, broadcast>::run;
+	case Cmp::GT_EQUAL: return &Impl<Cmp::GT_EQUAL, broadcast>::run;
+	case Cmp::LESS: return &Impl<Cmp::LESS, broadcast>::run;
+	default: return &Impl<Cmp::LT_EQUAL, broadcast>::run;
+	}
+}
+
+template <template <Cmp, bool> class Impl>
+static CompareFn pickCompare(Cmp cmp, bool broadcast) {
+	return broadcast ? pickCompare<Impl, true>(cmp) : pickCompare<Impl, false>(cmp);
+}
+
+static ArithFn arithFor(Kernels::Isa isa, Op op, bool broadcast, bool reversed) {
+	switch (isa) {
+#ifdef PROTO_X86
+	case Kernels::Isa::AVX2: return pickArith<Avx2Arith>(op, broadcast, reversed);
+	case Kernels::Isa::SSE2: return pickArith<Sse2Arith>(op, broadcast, reversed);
+#endif
+	default: return pickArith<ScalarArith>(op, broadcast, reversed);
+	}
+}
+
+static CompareFn compareFor(Kernels::Isa isa, Cmp cmp, bool broadcast) {
+	switch (isa) {
+#ifdef PROTO_X86
+	case Kernels::Isa::AVX2: return pickCompare<Avx2Compare>(cmp, broadcast);
+	case Kernels::Isa::SSE2: return pickCompare<Sse2Compare>(cmp, broadcast);
+#endif
+	default: return pickCompare<ScalarCompare>(cmp, broadcast);
+	}
+}
+
+Kernels::Kernels() : m_isa(detectIsa()) {
+	//! PROTO_KERNELS=scalar or sse2 caps the instruction set, for comparing against the fallbacks
+	if (auto cap = std::getenv("PROTO_KERNELS")) {
+		if (std::strcmp(cap, "scalar") == 0) m_isa = Isa::SCALAR;
+		else if (std::strcmp(cap, "sse2") == 0 && m_isa == Isa::AVX2) m_isa = Isa::SSE2;
+	}
+}
+
+Kernels& Kernels::getInstance() {
+	static Kernels kernels;
+	return kernels;
+}
+
+Kernels::Isa Kernels::isa() const {
+	return m_isa;
+}
+
+void Kernels::arith(Op op, const double* a, const double* b, double* out, std::size_t n) const {
+	arithFor(m_isa, op, false, false)(a, b, out, n);
+}
+
+void Kernels::arith(Op op, const double* a, double b, bool scalarLeft, double* out, std::size_t n) const {
+	arithFor(m_isa, op, true, scalarLeft)(a, &b, out, n);
+}
+
+void Kernels::compare(Cmp cmp, const double* a, const double* b, std::uint8_t* out, std::size_t n) const {
+	compareFor(m_isa, cmp, false)(a, b, out, n);
+}
+
+void Kernels::compare(Cmp cmp, const double* a, double b, std::uint8_t* out, std::size_t n) const {
+	compareFor(m_isa, cmp, true)(a, &b, out, n);
+}
+
+double Kernels::sum(const double* a, std::size_t n) const {
+	switch (m_isa) {
+#ifdef PROTO_X86
+	case Isa::AVX2: return sumAvx2(a, n);
+	case Isa::SSE2: return sumSse2(a, n);
+#endif
+	default: return sumScalar(a, n);
+	}
+}
+
+double Kernels::dot(const double* a, const double* b, std::size_t n) const {
+	switch (m_isa) {
+#ifdef PROTO_X86
+	case Isa::AVX2: return dotAvx2(a, b, n);
+	case Isa::SSE2: return dotSse2(a, b, n);
+#endif
+	default: return dotScalar(a, b, n);
+	}
+}
+
+double Kernels::min(const double* a, std::size_t n) const {
+	switch (m_isa) {
+#ifdef PROTO_X86
+	case Isa::AVX2: return minAvx2(a, n);
+	case Isa::SSE2: return minSse2(a, n);
+#endif
+	default: return minScalar(a, n);
+	}
+}
+
+double Kernels::max(const double* a, std::size_t n) const {
+	switch (m_isa) {
+#ifdef PROTO_X86
+	case Isa::AVX2: return maxAvx2(a, n);
+	case Isa::SSE2: return maxSse2(a, n);
+#endif
+	default: return maxScalar(a, n);
+	}
+}
@@ -1,56 +1,124 @@
 #include "includes/Lexer.hpp"
 #include "proto.hpp"
 
-#include <algorithm>
+#include <array>
+#include <cstdint>
+
+//! Character classes, looked up once per character instead of chains of comparisons
+enum CharClass : std::uint8_t {
+    DIGIT = 1,
+    IDENT_START = 2,    //letters and '_'
+    SPACE = 4           //' ', '\t', '\r' and '\n'
+};
+
+constexpr std::array<std::uint8_t, 256> makeCharClasses() {
+    std::array<std::uint8_t, 256> classes{};
+    for (int c = '0'; c <= '9'; c++) classes[c] = DIGIT;
+    for (int c = 'a'; c <= 'z'; c++) classes[c] = IDENT_START;
+    for (int c = 'A'; c <= 'Z'; c++) classes[c] = IDENT_START;
+    classes['_'] = IDENT_START;
+    classes[' '] = classes['\t'] = classes['\r'] = classes['\n'] = SPACE;
+    return classes;
+}
+
+constexpr auto charClasses = makeCharClasses();
+
+static bool hasClass(char c, std::uint8_t cls) {
+    return charClasses[static_cast<unsigned char>(c)] & cls;
+}
 
 bool Lexer::isAtEnd() const {
-    if (m_current >= m_src.length()) {
-        return true;
-    }
-    return false;
+    return m_current >= m_end;
 }
 
+//! Unchecked: only called where the current character isn't the sentinel
 char Lexer::advance() {
-    return m_src.at(m_current++);
+    return *m_current++;
 }
 
 void Lexer::addToken(TokenType type, LiteralType ltype) {
-    auto lexeme = m_src.substr(m_start, m_current - m_start);
-    if (ltype == LiteralType::STR) {
-        //! Make the lexeme the value of the str; remove the quotes
-        lexeme = lexeme.substr(1, lexeme.length() - 2);
-        
-        //! Facilitate escape sequences. Only \n, \t, \" and \\ are supported.
-        for (std::size_t i = 0; i < lexeme.length(); i++) {
-            if (lexeme.at(i) == '\\') {
-                if (i + 1 < lexeme.length()) {
-                    switch (lexeme.at(i + 1)) {
-                    case 'n':
-                        lexeme = lexeme.substr(0, i) + '\n' + lexeme.substr(i + 2);
-                        break;
-                    case 't':
-                        lexeme = lexeme.substr(0, i) + '\t' + lexeme.substr(i + 2);
-                        break;
-                    case '"':
-                        lexeme = lexeme.substr(0, i) + '"' + lexeme.substr(i + 2);
-                        break;
-                    case '\\':
-                        lexeme = lexeme.substr(0, i) + '\\' + lexeme.substr(i + 2);
-                        break;
-                    }
+    m_tokens.emplace_back(type, std::string_view(m_start, m_current - m_start), m_line, ltype);
+}
+
+//! Supported escapes: \n, \t, \r, \0, \", \\, \xHH and \u{H...} (a code point, written as
+//! UTF-8). Anything else after a backslash is kept as it is.
+std::string Lexer::unescape(std::string_view str, Proto& p) const {
+    std::string out;
+    out.reserve(str.length());
+
+    for (std::size_t i = 0; i < str.length(); i++) {
+        if (str[i] != '\\' || i + 1 == str.length()) {
+            out += str[i];
+            continue;
+        }
+        switch (str[++i]) {
+        case 'n': out += '\n'; break;
+        case 't': out += '\t'; break;
+        case 'r': out += '\r'; break;
+        case '0': out += '\0'; break;
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case 'x':
+            if (i + 2 < str.length() && hexValue(str[i + 1]) >= 0 && hexValue(str[i + 2]) >= 0) {
+                out += static_cast<char>(hexValue(str[i + 1]) * 16 + hexValue(str[i + 2]));
+                i += 2;
+            }
+            else p.error(m_line, "Expected two hex digits after \\x.");
+            break;
+        case 'u': {
+            auto close = str.find('}', i);
+            if (i + 1 == str.length() || str[i + 1] != '{' || close == std::string_view::npos || close - i - 2 > 6 || close == i + 2) {
+                p.error(m_line, "Expected 1 to 6 hex digits in braces after \\u.");
+                break;
+            }
+            std::uint32_t code = 0;
+            for (auto j = i + 2; j < close; j++) {
+                auto digit = hexValue(str[j]);
+                if (digit < 0) {
+                    p.error(m_line, "Expected 1 to 6 hex digits in braces after \\u.");
+                    return out;
                 }
+                code = code * 16 + digit;
+            }
+            if (code > 0x10ffff || (code >= 0xd800 && code <= 0xdfff)) {
+                p.error(m_line, "Not a unicode scalar value: ", std::string(str.substr(i - 1, close - i + 2)));
             }
+            else appendUtf8(out, code);
+            i = close;
+            break;
+        }
+        default:
+            out += '\\';
+            out += str[i];
         }
-        
     }
-    m_tokens.push_back(Token(type, lexeme, m_line, ltype));
+    return out;
 }
 
-bool Lexer::isNext(char c) {
-    if (isAtEnd()) {
-        return false;
+void Lexer::appendUtf8(std::string& out, std::uint32_t code) const {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
     }
-    if (m_src.at(m_current) != c) {
+    else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else if (code < 0x10000) {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+    else {
+        out += static_cast<char>(0xf0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+bool Lexer::isNext(char c) {
+    //! c is never '\0', so the sentinel doesn't match
+    if (*m_current != c) {
         return false;
     }
 
@@ -60,37 +128,41 @@ bool Lexer::isNext(char c) {
 }
 
 bool Lexer::isDigit(char c) const {
-    return c >= '0' && c <= '9';
+    return hasClass(c, DIGIT);
+}
+
+int Lexer::hexValue(char c) const {
+    if (isDigit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
 }
 
 bool Lexer::isAlphaOrUnderscore(char c) const {
-    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    return hasClass(c, IDENT_START);
 }
 
 bool Lexer::isAlphaNumeric(char c) const {
-    return isDigit(c) || isAlphaOrUnderscore(c);
+    return hasClass(c, DIGIT | IDENT_START);
 }
 
+//! '\0' at the end
 char Lexer::peek() const {
-    if (isAtEnd()) return '\0';
-    return m_src.at(m_current);
+    return *m_current;
 }
 
 char Lexer::peekby2() const {
-    if (m_current + 1 >= m_src.length()) return '\0';
-    return m_src.at(m_current + 1);
+    if (isAtEnd()) return '\0';
+    return m_current[1];
 }
 
 void Lexer::string(Proto& p) {
-    while (!isAtEnd()) {
-        if (peek() != '"') {
-            if (peek() == '\n') m_line++;
-            advance();
-        }
-        else if (m_src.at(m_current - 1) == '\\' && m_src.at(m_current - 2) != '\\') {
-            advance();
-        }
-        else break;
+    while (!isAtEnd() && peek() != '"') {
+        //! Whatever follows a backslash can't end the string
+        if (peek() == '\\') advance();
+        if (isAtEnd()) break;
+        if (peek() == '\n') m_line++;
+        advance();
     }
 
     ///Error if string is unterminated
@@ -102,7 +174,12 @@ void Lexer::string(Proto& p) {
     ///Found the closing quote
     advance();
 
-    addToken(TokenType::STRING, LiteralType::STR);
+    //! The value of the string is the lexeme without its quotes
+    auto val = std::string_view(m_start + 1, m_current - m_start - 2);
+    if (val.find('\\') != std::string_view::npos) {
+        val = m_unit.intern(unescape(val, p));
+    }
+    m_tokens.push_back(Token(TokenType::STRING, val, m_line, LiteralType::STR));
 }
 
 void Lexer::number(Proto& p) {
@@ -123,26 +200,27 @@ void Lexer::number(Proto& p) {
 
 void Lexer::identifierOrKeyword() {
     while (isAlphaNumeric(peek())) advance();
-    auto str = m_src.substr(m_start, m_current - m_start);
+    auto type = keywordType(std::string_view(m_start, m_current - m_start));
 
-    if (keywords.find(str)!=keywords.end()) {
-        if (str == "nix") {
-            addToken(keywords.at(str), LiteralType::NIX);
-            return;
-        }
-        if (str == "true") {
-            addToken(keywords.at(str), LiteralType::TRUE);
-            return;
-        }
-        if (str == "false") {
-            addToken(keywords.at(str), LiteralType::FALSE);
-            return;
-        }
-        
-        addToken(keywords.at(str));
-        return;
+    switch (type) {
+    case TokenType::NIX:
+        addToken(type, LiteralType::NIX);
+        break;
+    case TokenType::TRUE:
+        addToken(type, LiteralType::TRUE);
+        break;
+    case TokenType::FALSE:
+        addToken(type, LiteralType::FALSE);
+        break;
+    default:
+        addToken(type);
+    }
+}
+
+void Lexer::skipWhitespace() {
+    while (hasClass(peek(), SPACE)) {
+        if (advance() == '\n') m_line++;
     }
-    addToken(TokenType::IDENTIFIER);
 }
 
 void Lexer::scanToken(Proto& p) {
@@ -214,13 +292,6 @@ void Lexer::scanToken(Proto& p) {
         }
         else addToken(isNext('=') ? TokenType::DIV_EQUAL : TokenType::DIVISON);
         break;
-    case ' ': 
-    case '\t':
-    case '\r':
-        break;
-    case '\n':
-        m_line++;
-        break;
     case '"':
         string(p);
         break;
@@ -237,8 +308,10 @@ void Lexer::scanToken(Proto& p) {
 }
 
 std::vector<Token>& Lexer::scanTokens(Proto& p) {
+    //! Typical sources have a token every few characters, this saves most of the regrowing
+    m_tokens.reserve(m_src.size() / 8);
 
-    while (!isAtEnd()) {
+    for (skipWhitespace(); !isAtEnd(); skipWhitespace()) {
         m_start = m_current;
         scanToken(p);
     }
@@ -0,0 +1,163 @@
+#include <cmath>
+
+#include "includes/List.hpp"
+#include "includes/Expressions.hpp"
+
+list_t::list_t(Values&& list, Type type) : Obj(Obj::Type::LIST), m_type(type), m_length(list.size()) {
+	switch (m_type) {
+	case Type::numList:
+		m_nums = std::make_shared<std::vector<double>>();
+		m_nums->reserve(list.size());
+		for (auto& val : list) m_nums->push_back(val.asNum());
+		break;
+	case Type::boolList:
+		m_bools = std::make_shared<std::vector<bool>>();
+		m_bools->reserve(list.size());
+		for (auto& val : list) m_bools->push_back(val.asBool());
+		break;
+	default:
+		m_vals = std::make_shared<Values>(std::move(list));
+	}
+}
+
+list_t::list_t(const Values& list, Type type) : list_t(Values(list), type) {
+
+}
+
+list_t::list_t(std::vector<double>&& nums) : Obj(Obj::Type::LIST), m_type(Type::numList), m_length(nums.size()) {
+	m_nums = std::make_shared<std::vector<double>>(std::move(nums));
+}
+
+list_t::list_t(std::vector<bool>&& bools) : Obj(Obj::Type::LIST), m_type(Type::boolList), m_length(bools.size()) {
+	m_bools = std::make_shared<std::vector<bool>>(std::move(bools));
+}
+
+list_t::list_t(double first, double step, std::size_t count) : Obj(Obj::Type::LIST), m_type(Type::numList), m_length(count), m_lazy(true), m_first(first), m_step(step) {
+
+}
+
+void list_t::materialize() const {
+	m_nums = std::make_shared<std::vector<double>>(m_length);
+	for (std::size_t i = 0; i < m_length; i++) {
+		(*m_nums)[i] = m_first + static_cast<double>(i) * m_step;
+	}
+	m_lazy = false;
+}
+
+void list_t::detach() {
+	if (m_lazy) {
+		materialize();
+		return;
+	}
+	auto begin = m_offset;
+	auto end = m_offset + m_length;
+
+	switch (m_type) {
+	case Type::numList:
+		if (m_nums.use_count() == 1) return;
+		m_nums = std::make_shared<std::vector<double>>(m_nums->begin() + begin, m_nums->begin() + end);
+		break;
+	case Type::boolList:
+		if (m_bools.use_count() == 1) return;
+		m_bools = std::make_shared<std::vector<bool>>(m_bools->begin() + begin, m_bools->begin() + end);
+		break;
+	default:
+		if (m_vals.use_count() == 1) return;
+		m_vals = std::make_shared<Values>(m_vals->begin() + begin, m_vals->begin() + end);
+	}
+	m_offset = 0;
+}
+
+list_ptr list_t::slice(std::size_t start, std::size_t length) const {
+	auto view = make_obj<list_t>(*this);
+	if (m_lazy) view->m_first += static_cast<double>(start) * m_step;
+	else view->m_offset += start;
+	view->m_length = length;
+	return view;
+}
+
+std::size_t list_t::size() const {
+	return m_length;
+}
+
+bool list_t::empty() const {
+	return m_length == 0;
+}
+
+Value list_t::get(std::size_t i) const {
+	switch (m_type) {
+	case Type::numList: return m_lazy ? m_first + static_cast<double>(i) * m_step : (*m_nums)[m_offset + i];
+	case Type::boolList: return static_cast<bool>((*m_bools)[m_offset + i]);
+	default: return (*m_vals)[m_offset + i];
+	}
+}
+
+void list_t::set(std::size_t i, const Value& val) {
+	detach();
+	switch (m_type) {
+	case Type::numList: (*m_nums)[m_offset + i] = val.asNum(); break;
+	case Type::boolList: (*m_bools)[m_offset + i] = val.asBool(); break;
+	default: (*m_vals)[m_offset + i] = val;
+	}
+}
+
+list_ptr list_t::gather(const list_t& indices) const {
+	auto count = indices.size();
+	if (indices.m_lazy && (count == 1 || indices.m_step == 1)) {
+		return slice(static_cast<std::size_t>(indices.m_first) - 1, count);
+	}
+
+	if (m_type == Type::numList) {
+		std::vector<double> nums;
+		nums.reserve(count);
+		for (std::size_t i = 0; i < count; i++) {
+			nums.push_back(get(std::lround(indices.get(i).asNum()) - 1).asNum());
+		}
+		return make_obj<list_t>(std::move(nums));
+	}
+
+	Values vals;
+	vals.reserve(count);
+	for (std::size_t i = 0; i < count; i++) {
+		vals.push_back(get(std::lround(indices.get(i).asNum()) - 1));
+	}
+	return make_obj<list_t>(std::move(vals), m_type);
+}
+
+bool list_t::contains(double num) const {
+	if (m_lazy) {
+		auto i = std::round((num - m_first) / m_step);
+		if (!(i >= 0 && i < static_cast<double>(m_length))) return false;
+		return std::fabs(m_first + i * m_step - num) < epsilon;
+	}
+	auto nums = numData();
+	for (std::size_t i = 0; i < m_length; i++) {
+		if (std::fabs(nums[i] - num) < epsilon) return true;
+	}
+	return false;
+}
+
+bool list_t::isLazy() const {
+	return m_lazy;
+}
+
+const double* list_t::numData() const {
+	if (m_lazy) materialize();
+	return m_nums ? m_nums->data() + m_offset : nullptr;
+}
+
+//! A buffer shared with other lists is traced through Tracer::visitShared, so its values
+//! count once for all the lists that own it
+void list_t::trace(Tracer& tracer) {
+	if (!m_vals) return;
+	if (m_vals.use_count() > 1 && !tracer.visitShared(m_vals.get(), m_vals.use_count())) return;
+	for (auto& val : *m_vals) {
+		if (auto obj = val.obj()) tracer.visit(obj);
+	}
+}
+
+void list_t::clearRefs() {
+	m_vals.reset();
+	m_length = 0;
+	m_offset = 0;
+}
@@ -0,0 +1,57 @@
+#include <fstream>
+
+#include "includes/MappedFile.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifndef _WIN32
+	auto fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+
+	//! The rest of the last page reads as zeros, which is the '\0' promised after the data.
+	//! A file filling its last page exactly has nothing after it, so it's read instead.
+	struct stat info;
+	auto pageSize = ::sysconf(_SC_PAGESIZE);
+	if (::fstat(fd, &info) == 0 && info.st_size > 0 && pageSize > 0 && info.st_size % pageSize != 0) {
+		auto addr = ::mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			m_data = static_cast<const char*>(addr);
+			m_size = info.st_size;
+			m_open = m_mapped = true;
+		}
+	}
+	::close(fd);
+	if (m_mapped) return;
+#endif
+	//! One sized read, the std::string keeps the '\0'
+	std::ifstream file{ path, std::ios::binary | std::ios::ate };
+	if (!file) return;
+	auto size = file.tellg();
+	if (size < 0) return;
+	m_buffer.resize(static_cast<std::size_t>(size));
+	file.seekg(0);
+	if (!file.read(m_buffer.data(), size)) return;
+	m_data = m_buffer.data();
+	m_size = m_buffer.size();
+	m_open = true;
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+	if (m_mapped) ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+bool MappedFile::isOpen() const {
+	return m_open;
+}
+
+std::string_view MappedFile::view() const {
+	return { m_data, m_size };
+}
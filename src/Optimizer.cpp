@@ -0,0 +1,413 @@
+#include "includes/Optimizer.hpp"
+
+#include "includes/Arena.hpp"
+#include "includes/Interpreter.hpp"
+#include "includes/Lambda.hpp"
+
+Optimizer::Optimizer(Arena& unit) : m_unit(unit) {
+
+}
+
+Expr_ptr Optimizer::optimize(Expr_ptr expr) {
+	if (expr == nullptr) return nullptr;
+	expr->accept(this);
+	return m_expr;
+}
+
+Stmt_ptr Optimizer::optimize(Stmt_ptr stmt) {
+	if (stmt == nullptr) return nullptr;
+	stmt->accept(this);
+	return m_stmt;
+}
+
+bool Optimizer::optimize(Stmts& stmts) {
+	bool changed = false;
+	for (auto& stmt : stmts) {
+		auto optimized = optimize(stmt);
+		changed |= optimized != stmt;
+		stmt = optimized;
+	}
+	return changed;
+}
+
+Expr_ptr Optimizer::fold(const Expr& expr, std::size_t line) {
+	auto& interpreter = Interpreter::getInstance();
+	try {
+		expr.accept(&interpreter);
+	}
+	catch (const RuntimeError&) {
+		return nullptr;
+	}
+	auto folded = m_unit.make<Literal>(interpreter.m_val, line);
+	interpreter.m_val = nullptr;
+	return folded;
+}
+
+bool Optimizer::isLiteral(Expr_ptr expr) {
+	return dynamic_cast<const Literal*>(expr) != nullptr;
+}
+
+bool Optimizer::isNumber(Expr_ptr expr, double num) {
+	auto lit = dynamic_cast<const Literal*>(expr);
+	return lit && lit->m_val.isNum() && lit->m_val.asNum() == num;
+}
+
+bool Optimizer::isNumeric(Expr_ptr expr) {
+	if (auto lit = dynamic_cast<const Literal*>(expr)) return lit->m_val.isNum();
+	if (auto un = dynamic_cast<const Unary*>(expr)) return un->m_op.getType() == TokenType::MINUS;
+	if (auto bin = dynamic_cast<const Binary*>(expr)) {
+		switch (bin->m_op.getType()) {
+		//! A list on either side throws
+		case TokenType::EXPONENTATION: return true;
+		//! A list on either side gives a list
+		case TokenType::PLUS:
+		case TokenType::MINUS:
+		case TokenType::PRODUCT:
+		case TokenType::DIVISON: return isNumeric(bin->m_left) && isNumeric(bin->m_right);
+		default: return false;
+		}
+	}
+	return false;
+}
+
+bool Optimizer::isBoolean(Expr_ptr expr) {
+	if (auto lit = dynamic_cast<const Literal*>(expr)) return lit->m_val.isBool();
+	if (auto un = dynamic_cast<const Unary*>(expr)) return un->m_op.getType() == TokenType::NOT;
+	if (dynamic_cast<const Logical*>(expr)) return true;
+	if (auto bin = dynamic_cast<const Binary*>(expr)) {
+		switch (bin->m_op.getType()) {
+		case TokenType::EQ_EQUAL:
+		case TokenType::NOT_EQUAL: return true;
+		//! Comparing lists gives a list
+		case TokenType::GREATER:
+		case TokenType::GT_EQUAL:
+		case TokenType::LESS:
+		case TokenType::LT_EQUAL: return isNumeric(bin->m_left) && isNumeric(bin->m_right);
+		default: return false;
+		}
+	}
+	return false;
+}
+
+void Optimizer::visit(const Binary& bin) {
+	auto left = optimize(bin.m_left);
+	auto right = optimize(bin.m_right);
+
+	const Binary* node = &bin;
+	if (left != bin.m_left || right != bin.m_right) {
+		auto copy = m_unit.make<Binary>(bin);
+		copy->m_left = left;
+		copy->m_right = right;
+		node = copy;
+	}
+	m_expr = node;
+
+	if (isLiteral(left) && isLiteral(right)) {
+		if (auto folded = fold(*node, node->m_op.getLine())) m_expr = folded;
+		return;
+	}
+
+	switch (node->m_op.getType()) {
+	case TokenType::PRODUCT:
+		if (isNumber(right, 1) && isNumeric(left)) m_expr = left;
+		else if (isNumber(left, 1) && isNumeric(right)) m_expr = right;
+		break;
+	case TokenType::DIVISON:
+	case TokenType::EXPONENTATION:
+		if (isNumber(right, 1) && isNumeric(left)) m_expr = left;
+		break;
+	//! Not x + 0, which turns -0 into 0
+	case TokenType::MINUS:
+		if (isNumber(right, 0) && isNumeric(left)) m_expr = left;
+		break;
+	default:
+		break;
+	}
+}
+
+void Optimizer::visit(const Unary& un) {
+	auto right = optimize(un.m_right);
+
+	const Unary* node = &un;
+	if (right != un.m_right) {
+		auto copy = m_unit.make<Unary>(un);
+		copy->m_right = right;
+		node = copy;
+	}
+	m_expr = node;
+
+	if (isLiteral(right)) {
+		if (auto folded = fold(*node, node->m_op.getLine())) m_expr = folded;
+		return;
+	}
+
+	//! -(-x) and !(!x)
+	auto inner = dynamic_cast<const Unary*>(right);
+	if (inner == nullptr || inner->m_op.getType() != node->m_op.getType()) return;
+	if (node->m_op.getType() == TokenType::MINUS && isNumeric(inner->m_right)) m_expr = inner->m_right;
+	else if (node->m_op.getType() == TokenType::NOT && isBoolean(inner->m_right)) m_expr = inner->m_right;
+}
+
+//! Parentheses only matter to the parser. Around a call they're kept, since the repl
+//! prints the nix a parenthesized call returns.
+void Optimizer::visit(const ParenGroup& group) {
+	auto enclosed = optimize(group.m_enclosedExpr);
+	if (dynamic_cast<const Call*>(enclosed)) {
+		m_expr = &group;
+		if (enclosed != group.m_enclosedExpr) {
+			auto copy = m_unit.make<ParenGroup>(group);
+			copy->m_enclosedExpr = enclosed;
+			m_expr = copy;
+		}
+		return;
+	}
+	m_expr = enclosed;
+}
+
+void Optimizer::visit(const Literal& lit) {
+	m_expr = &lit;
+}
+
+void Optimizer::visit(const Variable& var) {
+	m_expr = &var;
+}
+
+void Optimizer::visit(const Logical& log) {
+	auto left = optimize(log.m_left);
+	auto right = optimize(log.m_right);
+
+	const Logical* node = &log;
+	if (left != log.m_left || right != log.m_right) {
+		auto copy = m_unit.make<Logical>(log);
+		copy->m_left = left;
+		copy->m_right = right;
+		node = copy;
+	}
+	m_expr = node;
+
+	if (!isLiteral(left)) return;
+
+	//! A constant left side either decides the result or leaves it to the right side
+	bool isOr = node->m_op.getType() == TokenType::OR;
+	bool decides = Interpreter::getInstance().isTrue(static_cast<const Literal*>(left)->m_val) == isOr;
+	if (decides || isLiteral(right)) {
+		if (auto folded = fold(*node, node->m_op.getLine())) m_expr = folded;
+	}
+	else if (isBoolean(right)) {
+		m_expr = right;
+	}
+}
+
+void Optimizer::visit(const Assign& expr) {
+	auto val = optimize(expr.m_val);
+	m_expr = &expr;
+	if (val != expr.m_val) {
+		auto copy = m_unit.make<Assign>(expr);
+		copy->m_val = val;
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const Call& expr) {
+	auto callee = optimize(expr.m_callee);
+	auto args = expr.m_args;
+	bool changed = callee != expr.m_callee;
+	for (auto& arg : args) {
+		auto optimized = optimize(arg);
+		changed |= optimized != arg;
+		arg = optimized;
+	}
+
+	m_expr = &expr;
+	if (changed) {
+		auto copy = m_unit.make<Call>(expr);
+		copy->m_callee = callee;
+		copy->m_args = std::move(args);
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const Lambda& expr) {
+	auto body = expr.m_body;
+	auto changed = optimize(body);
+	m_expr = &expr;
+	if (changed) {
+		auto copy = m_unit.make<Lambda>(expr);
+		copy->m_body = std::move(body);
+		m_expr = copy;
+	}
+}
+
+//! Lists are mutable, so even a list of literals is built on every evaluation
+void Optimizer::visit(const ListExpr& expr) {
+	auto exprs = expr.m_exprs;
+	bool changed = false;
+	for (auto& elem : exprs) {
+		auto optimized = optimize(elem);
+		changed |= optimized != elem;
+		elem = optimized;
+	}
+
+	m_expr = &expr;
+	if (changed) {
+		auto copy = m_unit.make<ListExpr>(expr);
+		copy->m_exprs = std::move(exprs);
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const Index& expr) {
+	auto list = optimize(expr.m_list);
+	auto index = optimize(expr.m_index);
+	m_expr = &expr;
+	if (list != expr.m_list || index != expr.m_index) {
+		auto copy = m_unit.make<Index>(expr);
+		copy->m_list = list;
+		copy->m_index = index;
+		m_expr = copy;
+	}
+}
+
+//! The bounds are folded like any other expression. The range itself is a (mutable) list,
+//! so it's still created on every evaluation, which is cheap since integral ranges are lazy.
+void Optimizer::visit(const RangeExpr& expr) {
+	auto first = optimize(expr.m_first);
+	auto step = optimize(expr.m_step);
+	auto end = optimize(expr.m_end);
+	m_expr = &expr;
+	if (first != expr.m_first || step != expr.m_step || end != expr.m_end) {
+		auto copy = m_unit.make<RangeExpr>(expr);
+		copy->m_first = first;
+		copy->m_step = step;
+		copy->m_end = end;
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const IndexAssign& expr) {
+	auto list = optimize(expr.m_list);
+	auto index = optimize(expr.m_index);
+	auto val = optimize(expr.m_val);
+	m_expr = &expr;
+	if (list != expr.m_list || index != expr.m_index || val != expr.m_val) {
+		auto copy = m_unit.make<IndexAssign>(expr);
+		copy->m_list = list;
+		copy->m_index = index;
+		copy->m_val = val;
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const InExpr& expr) {
+	auto iterable = optimize(expr.m_iterable);
+	m_expr = &expr;
+	if (iterable != expr.m_iterable) {
+		auto copy = m_unit.make<InExpr>(expr);
+		copy->m_iterable = iterable;
+		m_expr = copy;
+	}
+}
+
+void Optimizer::visit(const Expression& stmt) {
+	auto expr = optimize(stmt.m_expr);
+	m_stmt = &stmt;
+	if (expr != stmt.m_expr) {
+		auto copy = m_unit.make<Expression>(stmt);
+		copy->m_expr = expr;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const Block& block) {
+	auto stmts = block.m_stmts;
+	auto changed = optimize(stmts);
+	m_stmt = &block;
+	if (changed) {
+		auto copy = m_unit.make<Block>(block);
+		copy->m_stmts = std::move(stmts);
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const If& stmt) {
+	auto condition = optimize(stmt.m_condition);
+	auto thenBranch = optimize(stmt.m_thenBranch);
+	auto elseBranch = optimize(stmt.m_elseBranch);
+	m_stmt = &stmt;
+	if (condition != stmt.m_condition || thenBranch != stmt.m_thenBranch || elseBranch != stmt.m_elseBranch) {
+		auto copy = m_unit.make<If>(stmt);
+		copy->m_condition = condition;
+		copy->m_thenBranch = thenBranch;
+		copy->m_elseBranch = elseBranch;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const While& stmt) {
+	auto condition = optimize(stmt.m_condition);
+	auto body = optimize(stmt.m_body);
+	m_stmt = &stmt;
+	if (condition != stmt.m_condition || body != stmt.m_body) {
+		auto copy = m_unit.make<While>(stmt);
+		copy->m_condition = condition;
+		copy->m_body = body;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const For& stmt) {
+	auto init = optimize(stmt.m_init);
+	auto condition = optimize(stmt.m_condition);
+	auto increment = optimize(stmt.m_increment);
+	auto body = optimize(stmt.m_body);
+	m_stmt = &stmt;
+	if (init != stmt.m_init || condition != stmt.m_condition || increment != stmt.m_increment || body != stmt.m_body) {
+		auto copy = m_unit.make<For>(stmt);
+		copy->m_init = init;
+		copy->m_condition = condition;
+		copy->m_increment = increment;
+		copy->m_body = body;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const RangedFor& stmt) {
+	auto inexpr = optimize(stmt.m_inexpr);
+	auto body = optimize(stmt.m_body);
+	m_stmt = &stmt;
+	if (inexpr != stmt.m_inexpr || body != stmt.m_body) {
+		auto copy = m_unit.make<RangedFor>(stmt);
+		copy->m_inexpr = inexpr;
+		copy->m_body = body;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const Func& func) {
+	auto body = func.m_body;
+	auto changed = optimize(body);
+	m_stmt = &func;
+	if (changed) {
+		auto copy = m_unit.make<Func>(func);
+		copy->m_body = std::move(body);
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const Return& stmt) {
+	auto val = optimize(stmt.m_val);
+	m_stmt = &stmt;
+	if (val != stmt.m_val) {
+		auto copy = m_unit.make<Return>(stmt);
+		copy->m_val = val;
+		m_stmt = copy;
+	}
+}
+
+void Optimizer::visit(const Break& stmt) {
+	m_stmt = &stmt;
+}
+
+void Optimizer::visit(const Continue& stmt) {
+	m_stmt = &stmt;
+}
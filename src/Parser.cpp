@@ -4,7 +4,7 @@
 #include "includes/Lambda.hpp"
 #include "proto.hpp"
 
-Parser::Parser(std::vector<Token>& tokens, bool parseRepl) : m_tokens(tokens), m_current(0), m_allowExpr(parseRepl), m_foundExpr(false), m_loopDepth(0){
+Parser::Parser(const std::vector<Token>& tokens, Arena& arena, bool parseRepl) : m_tokens(tokens), m_arena(arena), m_current(0), m_allowExpr(parseRepl), m_foundExpr(false), m_loopDepth(0){
 
 }
 
@@ -14,7 +14,7 @@ std::variant<Stmts, Expr_ptr> Parser::parse() {
 		statements.push_back(statement());
 
 		if (m_foundExpr) {
-			if (auto a = std::static_pointer_cast<Expression>(statements.back())) {
+			if (auto a = static_cast<const Expression*>(statements.back())) {
 				return a->m_expr;
 			}
 		}
@@ -27,11 +27,11 @@ bool Parser::isAtEnd() {
 	return peek().getType() == TokenType::EOF_;
 }
 
-Token Parser::peek() {
+const Token& Parser::peek() {
 	return m_tokens.at(m_current);
 }
 
-Token Parser::previous() {
+const Token& Parser::previous() {
 	return m_tokens.at(m_current - 1);
 }
 
@@ -46,7 +46,7 @@ bool Parser::isNextNextType(TokenType type) {
 	return m_tokens.at(m_current + 1).getType() == type;
 }
 
-Token Parser::advance() { 
+const Token& Parser::advance() { 
 	if (!isAtEnd()) m_current++;
 	return previous();
 }
@@ -70,7 +70,7 @@ bool Parser::match(TokenType type) {
 	return false;
 }
 
-ParseError Parser::error(Token t, std::string_view msg){
+ParseError Parser::error(const Token& t, std::string_view msg){
 	Proto::getInstance().error(t.getLine(), msg);
 	return ParseError{ msg };
 }
@@ -111,33 +111,38 @@ void Parser::sync() {
 //! Production rules
 
 Stmt_ptr Parser::statement() {
+	auto line = peek().getLine();
 	try {
-		if (match( TokenType::RETURN )) {
-			return returnstmt();
-		}
-		if (isNextType(TokenType::FUNCTION) && isNextNextType(TokenType::IDENTIFIER)) {
-			advance();	//consume the fn
-			return fndefn();
-		}
-		if (match(TokenType::LBRACE)) {
-			return std::make_shared<Block>(block());
-		}
-		if (match(TokenType::IF)) {
-			return ifstmt();
-		}
-		if (match(TokenType::WHILE)) {
-			return whilestmt();
-		}
-		if (match(TokenType::FOR)) {
-			return forstmt();
-		}
-		if (match(TokenType::BREAK)) {
-			return breakstmt();
-		}
-		if (match(TokenType::CONTINUE)) {
-			return contstmt();
-		}
-		return exprstmt();
+		auto stmt = [&]() -> Stmt_ptr {
+			if (match( TokenType::RETURN )) {
+				return returnstmt();
+			}
+			if (isNextType(TokenType::FUNCTION) && isNextNextType(TokenType::IDENTIFIER)) {
+				advance();	//consume the fn
+				return fndefn();
+			}
+			if (match(TokenType::LBRACE)) {
+				return m_arena.make<Block>(block());
+			}
+			if (match(TokenType::IF)) {
+				return ifstmt();
+			}
+			if (match(TokenType::WHILE)) {
+				return whilestmt();
+			}
+			if (match(TokenType::FOR)) {
+				return forstmt();
+			}
+			if (match(TokenType::BREAK)) {
+				return breakstmt();
+			}
+			if (match(TokenType::CONTINUE)) {
+				return contstmt();
+			}
+			return exprstmt();
+		}();
+		if (stmt) stmt->m_line = line;
+		return stmt;
 	}
 	catch (const ParseError&) {
 		sync();
@@ -166,7 +171,7 @@ Stmt_ptr Parser::ifstmt() {
 		elseBranch = statement();
 	}
 
-	return std::make_shared<If>(condition, then, elseBranch);
+	return m_arena.make<If>(condition, then, elseBranch);
 }
 
 Stmt_ptr Parser::whilestmt() {
@@ -177,7 +182,7 @@ Stmt_ptr Parser::whilestmt() {
 	m_loopDepth++;
 	auto body = statement();
 	m_loopDepth--;
-	return std::make_shared<While>(condition, body);
+	return m_arena.make<While>(condition, body);
 }
 
 Stmt_ptr Parser::forstmt() {
@@ -190,7 +195,7 @@ Stmt_ptr Parser::forstmt() {
 	else {
 		init = expression();
 
-		if (auto in = std::dynamic_pointer_cast<InExpr>(init)) {
+		if (auto in = dynamic_cast<const InExpr*>(init)) {
 			//we have a range based for loop
 
 			//! make sure to consume the right paren
@@ -199,7 +204,7 @@ Stmt_ptr Parser::forstmt() {
 			m_loopDepth++;
 			Stmt_ptr body = statement();
 			m_loopDepth--;
-			return std::make_shared<RangedFor>(in, body);
+			return m_arena.make<RangedFor>(in, body);
 		}
 
 		matchWithErr(TokenType::SEMICOLON, "Expected a ';' after for-loop initialization clause.");
@@ -223,9 +228,9 @@ Stmt_ptr Parser::forstmt() {
 	Stmt_ptr body = statement();
 	m_loopDepth--;
 
-	if (condition == nullptr) condition = std::make_shared<Literal>(Token(TokenType::TRUE, "true", 0, LiteralType::TRUE));
+	if (condition == nullptr) condition = m_arena.make<Literal>(Token(TokenType::TRUE, "true", 0, LiteralType::TRUE));
 
-	return std::make_shared<For>(init, condition, increment, body);
+	return m_arena.make<For>(init, condition, increment, body);
 }
 
 Stmt_ptr Parser::breakstmt() {
@@ -233,7 +238,7 @@ Stmt_ptr Parser::breakstmt() {
 		error(previous(), "Cannot use 'break' outside of a loop.");
 	}
 	matchWithErr(TokenType::SEMICOLON, "Expected a ';' after 'break'.");
-	return std::make_shared<Break>();
+	return m_arena.make<Break>();
 }
 
 Stmt_ptr Parser::contstmt() {
@@ -241,14 +246,14 @@ Stmt_ptr Parser::contstmt() {
 		error(previous(), "Cannot use 'continue' outside of a loop.");
 	}
 	matchWithErr(TokenType::SEMICOLON, "Expected a ';' after 'continue'.");
-	return std::make_shared<Continue>();
+	return m_arena.make<Continue>();
 }
 
 Stmt_ptr Parser::exprstmt() {
 	auto expr = expression();
 	if (m_allowExpr && isAtEnd()) m_foundExpr = true;
 	else matchWithErr(TokenType::SEMICOLON, "Invalid Syntax. Did you miss a ';' after the expression?");
-	return std::make_shared<Expression>(expr);
+	return m_arena.make<Expression>(expr);
 }
 
 Stmt_ptr Parser::fndefn() {
@@ -268,7 +273,7 @@ Stmt_ptr Parser::fndefn() {
 
 	matchWithErr(TokenType::RPAREN, "Expected a ')' after function parameters.");
 	matchWithErr(TokenType::LBRACE, "Expected a '{' before function body.");
-	return std::make_shared<Func>(name, params, block());
+	return m_arena.make<Func>(name, params, block(), &m_arena);
 }
 
 Stmt_ptr Parser::returnstmt() {
@@ -278,7 +283,7 @@ Stmt_ptr Parser::returnstmt() {
 		val = expression();
 	}
 	matchWithErr(TokenType::SEMICOLON, "Expected a ';' after return value.");
-	return std::make_shared<Return>(keyword, val);
+	return m_arena.make<Return>(keyword, val);
 }
 
 Expr_ptr Parser::expression() {
@@ -292,13 +297,13 @@ Expr_ptr Parser::assignment() {
 		Token op = previous();
 		Expr_ptr val = assignment();
 
-		if (auto var = std::dynamic_pointer_cast<Variable>(expr)) {
+		if (auto var = dynamic_cast<const Variable*>(expr)) {
 			auto name = var->m_name;
-			return std::make_shared<Assign>(name, op, val);
+			return m_arena.make<Assign>(name, op, val);
 		}
 
-		if (auto index = std::dynamic_pointer_cast<Index>(expr)) {
-			return std::make_shared<IndexAssign>(index->m_list, index->m_index, index->m_indexOp, op, val);
+		if (auto index = dynamic_cast<const Index*>(expr)) {
+			return m_arena.make<IndexAssign>(index->m_list, index->m_index, index->m_indexOp, op, val);
 		}
 
 		error(op, "Invalid assignment location.");
@@ -316,29 +321,29 @@ Expr_ptr Parser::assignment() {
 			a /= 2 => a `= a / 2
 		*/
 
-		if (auto var = std::dynamic_pointer_cast<Variable>(expr)) {
+		if (auto var = dynamic_cast<const Variable*>(expr)) {
 			
 			switch (op.getType()) {
 			case TokenType::PLUS_EQUAL:
 				op = Token(TokenType::PLUS, "+", op.getLine(), LiteralType::NONE);
-				val = std::make_shared<Binary>(var, op, val);
+				val = m_arena.make<Binary>(var, op, val);
 				break;
 			case TokenType::MINUS_EQUAL:
 				op = Token(TokenType::MINUS, "-", op.getLine(), LiteralType::NONE);
-				val = std::make_shared<Binary>(var, op, val);
+				val = m_arena.make<Binary>(var, op, val);
 				break;
 			case TokenType::PROD_EQUAL:
 				op = Token(TokenType::PRODUCT, "*", op.getLine(), LiteralType::NONE);
-				val = std::make_shared<Binary>(var, op, val);
+				val = m_arena.make<Binary>(var, op, val);
 				break;
 			case TokenType::DIV_EQUAL:
 				op = Token(TokenType::DIVISON, "/", op.getLine(), LiteralType::NONE);
-				val = std::make_shared<Binary>(var, op, val);
+				val = m_arena.make<Binary>(var, op, val);
 				break;
 			}
 
 			op  = Token(TokenType::BT_EQUAL, "`=", op.getLine(), LiteralType::NONE);
-			return std::make_shared<Assign>(var->m_name, op, val);
+			return m_arena.make<Assign>(var->m_name, op, val);
 		}
 		else {
 			error(op, "Invalid assignment location.");
@@ -348,9 +353,9 @@ Expr_ptr Parser::assignment() {
 	if (match(TokenType::IN)) {
 		Token in = previous();
 		Expr_ptr iterable = assignment();
-		if (auto var = std::dynamic_pointer_cast<Variable>(expr)) {
+		if (auto var = dynamic_cast<const Variable*>(expr)) {
 			auto name = var->m_name;
-			return std::make_shared<InExpr>(name, in, iterable);
+			return m_arena.make<InExpr>(name, in, iterable);
 		}
 		error(in, "Missing identifier for iterating variable.");
 	}
@@ -364,7 +369,7 @@ Expr_ptr Parser::lor() {
 	while (match(TokenType::OR)) {
 		Token op = previous();
 		auto right = land();
-		expr = std::make_shared<Logical>(expr, op, right);
+		expr = m_arena.make<Logical>(expr, op, right);
 	}
 
 	return expr;
@@ -376,7 +381,7 @@ Expr_ptr Parser::land() {
 	while (match(TokenType::AND)) {
 		Token op = previous();
 		auto right = equality();
-		expr = std::make_shared<Logical>(expr, op, right);
+		expr = m_arena.make<Logical>(expr, op, right);
 	}
 
 	return expr;
@@ -388,7 +393,7 @@ Expr_ptr Parser::equality() {
 	while (match({ TokenType::NOT_EQUAL, TokenType::EQ_EQUAL })) {
 		Token op = previous();
 		auto right = comparision();
-		expr = std::make_shared<Binary>(expr, op, right);
+		expr = m_arena.make<Binary>(expr, op, right);
 	}
 	return expr;
 }
@@ -399,7 +404,7 @@ Expr_ptr Parser::comparision() {
 	while (match({ TokenType::GREATER, TokenType::GT_EQUAL, TokenType::LESS, TokenType::LT_EQUAL })) {
 		Token op = previous();
 		auto right = range();
-		expr = std::make_shared<Binary>(expr, op, right);
+		expr = m_arena.make<Binary>(expr, op, right);
 	}
 
 	return expr;
@@ -412,10 +417,10 @@ Expr_ptr Parser::range() {
 		auto expr2 = addition();
 		if (match(TokenType::DOT_DOT)) {
 			auto expr3 = addition();
-			expr = std::make_shared<RangeExpr>(expr, expr2, expr3, op);
+			expr = m_arena.make<RangeExpr>(expr, expr2, expr3, op);
 		}
 		else {
-			expr = std::make_shared<RangeExpr>(expr, expr2, op);
+			expr = m_arena.make<RangeExpr>(expr, expr2, op);
 		}
 	}
 
@@ -428,7 +433,7 @@ Expr_ptr Parser::addition() {
 	while (match({ TokenType::PLUS, TokenType::MINUS })) {
 		Token op = previous();
 		auto right = product();
-		expr = std::make_shared<Binary>(expr, op, right);
+		expr = m_arena.make<Binary>(expr, op, right);
 	}
 
 	return expr;
@@ -440,7 +445,7 @@ Expr_ptr Parser::product() {
 	while (match({ TokenType::PRODUCT, TokenType::DIVISON })) {
 		Token op = previous();
 		auto right = unary();
-		expr = std::make_shared<Binary>(expr, op, right);
+		expr = m_arena.make<Binary>(expr, op, right);
 	}
 
 	return expr;
@@ -450,7 +455,7 @@ Expr_ptr Parser::unary() {
 	if (match({ TokenType::NOT, TokenType::MINUS })) {
 		Token op = previous();
 		auto right = unary();
-		return std::make_shared<Unary>(op, right);
+		return m_arena.make<Unary>(op, right);
 	}
 
 	return exponentiation();
@@ -461,7 +466,7 @@ Expr_ptr Parser::exponentiation() {
 	if (match(TokenType::EXPONENTATION)) {
 		Token op = previous();
 		auto power = exponentiation();
-		base = std::make_shared<Binary>(base, op, power);
+		base = m_arena.make<Binary>(base, op, power);
 	}
 	return base;
 }
@@ -483,7 +488,7 @@ Expr_ptr Parser::index_or_call() {
 
 			matchWithErr(TokenType::RPAREN, "Expected a ')' after function arguments.");
 			auto paren = previous();
-			expr = std::make_shared<Call>(expr, paren, args);
+			expr = m_arena.make<Call>(expr, paren, args);
 		}
 
 		//indexing
@@ -492,12 +497,12 @@ Expr_ptr Parser::index_or_call() {
 			if (match(TokenType::LSQRBRKT)) {
 				//list indexing
 				auto listIndex = list();
-				expr = std::make_shared<Index>(tok, expr, listIndex);
+				expr = m_arena.make<Index>(tok, expr, listIndex);
 			}
 			else {
 				auto index = expression();
 				//can be a number or a range (which turns to a list)
-				expr = std::make_shared<Index>(tok, expr, index);
+				expr = m_arena.make<Index>(tok, expr, index);
 			}
 
 			matchWithErr(TokenType::RSQRBRKT, "Expected a ']' after index end.");
@@ -510,17 +515,17 @@ Expr_ptr Parser::index_or_call() {
 
 Expr_ptr Parser::primary() {
 	if (match({ TokenType::TRUE, TokenType::FALSE, TokenType::NIX, TokenType::NUMBER, TokenType::STRING })) {
-		return std::make_shared<Literal>(previous());
+		return m_arena.make<Literal>(previous());
 	}
 
 	if (match(TokenType::LPAREN)) {
 		auto expr = expression();
 		matchWithErr(TokenType::RPAREN, "Expected ')' after expression.");
-		return std::make_shared<ParenGroup>(expr);
+		return m_arena.make<ParenGroup>(expr);
 	}
 
 	if (match(TokenType::IDENTIFIER)) {
-		return std::make_shared<Variable>(previous());
+		return m_arena.make<Variable>(previous());
 	}
 
 	if (match(TokenType::FUNCTION)) {
@@ -538,7 +543,7 @@ Expr_ptr Parser::primary() {
 
 		matchWithErr(TokenType::RPAREN, "Expected a ')' after lambda parameters.");
 		matchWithErr(TokenType::LBRACE, "Expected a '{' before lambda body.");
-		return std::make_shared<Lambda>(params, block());
+		return m_arena.make<Lambda>(params, block(), &m_arena);
 	}
 
 	if (match(TokenType::LSQRBRKT)) {
@@ -559,5 +564,5 @@ Expr_ptr Parser::list() {
 	}
 
 	matchWithErr(TokenType::RSQRBRKT, "Expected a ']' after list end.");
-	return std::make_shared<ListExpr>(expressions, lsqrbrkt);
+	return m_arena.make<ListExpr>(expressions, lsqrbrkt);
 }
\ No newline at end of file
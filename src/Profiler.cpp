@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <unordered_set>
+
+#include "includes/Profiler.hpp"
+
+Profiler& Profiler::getInstance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+//! A joinable thread can't be destroyed, in case stop was never called
+Profiler::~Profiler() {
+	m_running = false;
+	if (m_ticker.joinable()) m_ticker.join();
+}
+
+void Profiler::start(std::string output) {
+	m_output = std::move(output);
+	m_running = true;
+	m_ticker = std::thread([this] {
+		while (m_running) {
+			std::this_thread::sleep_for(INTERVAL);
+			m_pending.fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+}
+
+void Profiler::sample(const std::vector<Frame>& stack) {
+	auto ticks = m_pending.exchange(0, std::memory_order_relaxed);
+	if (ticks == 0 || stack.empty()) return;
+	m_ticks += ticks;
+
+	std::string folded;
+	std::unordered_set<std::string_view> seen;
+	for (auto& frame : stack) {
+		auto name = frame.m_name.empty() ? std::string_view("<lambda>") : frame.m_name;
+		if (!folded.empty()) folded += ';';
+		folded.append(name);
+		if (frame.m_isTail) folded += "[tail]";
+		folded += ':';
+		folded += std::to_string(frame.m_line);
+
+		if (seen.insert(name).second) m_functions[std::string(name)].m_total += ticks;
+	}
+	auto leaf = stack.back().m_name.empty() ? std::string_view("<lambda>") : stack.back().m_name;
+	m_functions[std::string(leaf)].m_self += ticks;
+	m_stacks[folded] += ticks;
+}
+
+void Profiler::stop(std::ostream& out, std::size_t top) {
+	m_running = false;
+	if (m_ticker.joinable()) m_ticker.join();
+
+	std::ofstream file{ m_output };
+	for (auto& [stack, ticks] : m_stacks) {
+		file << stack << ' ' << ticks << '\n';
+	}
+
+	std::vector<std::pair<std::string, Times>> functions(m_functions.begin(), m_functions.end());
+	std::sort(functions.begin(), functions.end(), [](auto& a, auto& b) {
+		return a.second.m_self != b.second.m_self ? a.second.m_self > b.second.m_self : a.second.m_total > b.second.m_total;
+	});
+	if (functions.size() > top) functions.resize(top);
+
+	auto ms = [](std::size_t ticks) { return std::chrono::duration<double, std::milli>(INTERVAL * ticks).count(); };
+	auto percent = [this](std::size_t ticks) { return m_ticks ? 100.0 * ticks / m_ticks : 0; };
+
+	out << std::fixed << std::setprecision(1)
+		<< "[Profile] " << m_ticks << " samples (" << ms(m_ticks) << "ms), " << m_tailCalls << " tail calls eliminated"
+		<< (file ? ", folded stacks written to " + m_output : ", couldn't write " + m_output) << '\n'
+		<< std::setw(10) << "self ms" << std::setw(8) << "self%" << std::setw(10) << "total ms" << std::setw(8) << "total%" << "  function\n";
+	for (auto& [name, times] : functions) {
+		out << std::setw(10) << ms(times.m_self) << std::setw(8) << percent(times.m_self)
+			<< std::setw(10) << ms(times.m_total) << std::setw(8) << percent(times.m_total) << "  " << name << '\n';
+	}
+}
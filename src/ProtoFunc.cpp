@@ -1,12 +1,13 @@
+#include <algorithm>
+
 #include "includes/ProtoFunc.hpp"
 #include "includes/Interpreter.hpp"
-#include "includes/ReturnThrow.hpp"
 
-ProtoFunction::ProtoFunction(Token name, const std::vector<Token>& params, Stmts body) : m_name(name.str()), m_params(params), m_body(body) {
+ProtoFunction::ProtoFunction(Token name, const std::vector<Token>& params, Stmts body, std::size_t scopeSize, Upvalues upvalues, std::shared_ptr<Arena> unit) : m_name(name.str()), m_params(params), m_body(body), m_scopeSize(scopeSize), m_upvalues(std::move(upvalues)), m_unit(std::move(unit)) {
 
 }
 
-ProtoFunction::ProtoFunction(const std::string& name, const std::vector<Token>& params, Stmts body) : m_name(name), m_params(params), m_body(body) {
+ProtoFunction::ProtoFunction(const std::string& name, const std::vector<Token>& params, Stmts body, std::size_t scopeSize, Upvalues upvalues, std::shared_ptr<Arena> unit) : m_name(name), m_params(params), m_body(body), m_scopeSize(scopeSize), m_upvalues(std::move(upvalues)), m_unit(std::move(unit)) {
 
 }
 
@@ -18,19 +19,62 @@ std::string ProtoFunction::info() {
 	return (m_name == "") ? "<Proto::generic::userfn::lambda>" :"<Proto::generic::userfn " + m_name + ">";
 }
 
-Value ProtoFunction::call(const Values& args) {
-	Env_ptr callEnv = std::make_shared<Environment>(Interpreter::getInstance().m_env);
+Value ProtoFunction::call(Args args) {
+	auto& stack = Interpreter::getInstance().m_stack;
+	auto frame = stack.size();
+	stack.insert(stack.end(), args.begin(), args.end());
+	return callInPlace(frame);
+}
 
-	for (std::size_t i = 0; i < args.size(); i++) {
-		callEnv->assign(m_params[i].str(), args[i]);
-	}
-	
-	try {
-		Interpreter::getInstance().executeBlock(m_body, callEnv);
+Value ProtoFunction::callInPlace(std::size_t frame) {
+	auto& interpreter = Interpreter::getInstance();
+	auto enclosingFrame = interpreter.m_frame;
+	auto enclosing = interpreter.m_upvalues;
+	interpreter.m_frame = frame;
+	interpreter.m_calls.push_back({ m_name, 0 });
+
+	//! A tail call leaves its callee in m_tailCall and the arguments on top of the stack.
+	//! Those become this frame's, so tail recursion runs in constant space.
+	obj_ptr<ProtoFunction> tailCallee;
+	auto fn = this;
+	while (true) {
+		//! The rest of the outermost scope's slots follow the arguments. Nested scopes don't
+		//! reach past the call either, whatever the function uses from outside is global or
+		//! an upvalue, so they can start from the global environment.
+		interpreter.m_stack.resize(frame + fn->m_scopeSize, Value::undefined());
+		interpreter.m_upvalues = &fn->m_upvalues;
+
+		//! executeBlock reports runtime errors itself, so nothing unwinds past the pops
+		interpreter.executeBlock(fn->m_body, interpreter.m_global);
+		if (!interpreter.m_tailCall) break;
+
+		tailCallee = std::move(interpreter.m_tailCall);
+		fn = tailCallee.get();
+		auto& stack = interpreter.m_stack;
+		std::move(stack.end() - fn->arity(), stack.end(), stack.begin() + frame);
+		stack.resize(frame + fn->arity());
+		interpreter.m_completion = Interpreter::Completion::NORMAL;
+		interpreter.m_calls.back() = { fn->m_name, 0, true };
+		Profiler::getInstance().tailCall();
 	}
-	catch (const ReturnThrow& rtrn) {
-		return rtrn.m_val;
+	interpreter.m_calls.pop_back();
+	interpreter.m_frame = enclosingFrame;
+	interpreter.m_upvalues = enclosing;
+	interpreter.m_stack.resize(frame);
+
+	if (interpreter.m_completion == Interpreter::Completion::RETURN) {
+		interpreter.m_completion = Interpreter::Completion::NORMAL;
+		return interpreter.m_val;
 	}
-	
 	return nullptr;
 }
+
+void ProtoFunction::trace(Tracer& tracer) {
+	for (auto& upvalue : m_upvalues) {
+		tracer.visit(upvalue.get());
+	}
+}
+
+void ProtoFunction::clearRefs() {
+	m_upvalues.clear();
+}
@@ -6,15 +6,27 @@
 
 void Resolver::beginScope() {
 	m_scopes.push_back({});
+	m_scopeRefs.push_back(m_localRefs.size());
 }
 
-void Resolver::endScope() {
+std::size_t Resolver::endScope() {
 	auto& scope = m_scopes.back();
 	for (auto& [name, var] : scope) {
 		if (!var.hasBeenRead)
 			Proto::getInstance().warn(var.line, "Unused local variable '" + name + "'.");
 	}
+	auto size = scope.size();
+	auto index = m_scopes.size() - 1;
+	if (size == 0) {
+		for (auto i = m_scopeRefs.back(); i < m_localRefs.size(); i++) {
+			auto& ref = m_localRefs[i];
+			if (ref.m_scope < index && index <= ref.m_from) ref.m_resolved->m_depth--;
+		}
+	}
 	m_scopes.pop_back();
+	m_scopeRefs.pop_back();
+	if (m_scopes.empty()) m_localRefs.clear();
+	return size;
 }
 
 void Resolver::resolve(const Stmt_ptr stmt) {
@@ -27,26 +39,73 @@ void Resolver::resolve(const Expr_ptr expr) {
 
 void Resolver::define(Token name) {
 	if (m_scopes.empty()) return;
-	m_scopes.back()[name.str()] = { name.getLine(), false };
+	auto& scope = m_scopes.back();
+
+	//! A redefinition reuses the slot of the existing variable
+	auto var = scope.find(name.str());
+	auto slot = (var != scope.end()) ? var->second.slot : scope.size();
+	scope[name.str()] = { name.getLine(), false, slot };
 }
 
-void Resolver::resolveLocal(const Expr& expr, Token name, bool hasBeenRead) {
+void Resolver::resolveLocal(Resolution& resolved, Token name, bool hasBeenRead) {
 	if (!m_scopes.empty())
 		for (int i = m_scopes.size() - 1; i >= 0; i--) {
-			if (m_scopes[i].find(name.str()) != m_scopes[i].end()) {
-				Interpreter::getInstance().resolve(expr, m_scopes.size() - i - 1);
+			auto var = m_scopes[i].find(name.str());
+			if (var != m_scopes[i].end()) {
+				auto scope = static_cast<std::size_t>(i);
+				auto level = m_functions.size();
+				if (level && scope == m_functions.back().m_base) {
+					resolved = { true, 0, var->second.slot, false, true };
+				}
+				else if (functionLevel(scope) == level) {
+					resolved = { true, m_scopes.size() - scope - 1, var->second.slot };
+					m_localRefs.push_back({ &resolved, scope, m_scopes.size() - 1 });
+				}
+				else resolved = { true, 0, addUpvalue(level, scope, var->second.slot), true };
 				if (hasBeenRead) {
-					m_scopes[i].at(name.str()).hasBeenRead = true;
+					var->second.hasBeenRead = true;
 				}
 				return;
 			}
 		}
+	resolved = {};
+}
+
+std::size_t Resolver::functionLevel(std::size_t scope) {
+	auto level = m_functions.size();
+	while (level && m_functions[level - 1].m_base > scope) level--;
+	return level;
+}
+
+std::size_t Resolver::addUpvalue(std::size_t level, std::size_t scope, std::size_t slot) {
+	auto& fn = m_functions[level - 1];
+	auto [index, added] = fn.m_indices.try_emplace({ scope, slot }, fn.m_captures->size());
+	if (!added) return index->second;
+
+	//! Captured where the function is created, from a local of the enclosing function
+	//! or from one of its upvalues
+	auto& captured = fn.m_captures->emplace_back();
+	if (level > 1 && scope == m_functions[level - 2].m_base) {
+		captured = { true, 0, slot, false, true };
+	}
+	else if (functionLevel(scope) == level - 1) {
+		captured = { true, fn.m_base - 1 - scope, slot };
+		m_localRefs.push_back({ &captured, scope, fn.m_base - 1 });
+	}
+	else captured = { true, 0, addUpvalue(level - 1, scope, slot), true };
+	return index->second;
+}
+
+void Resolver::beginFunction(Captures& captures) {
+	captures.clear();
+	m_functions.push_back({ m_scopes.size(), &captures, {} });
+	beginScope();
 }
 
 void Resolver::resolveFunc(const Func& f) {
 	bool temp = inFunction;
 	inFunction = true;
-	beginScope();
+	beginFunction(f.m_captures);
 	for (auto& param : f.m_params) {
 		define(param);
 	}
@@ -57,7 +116,8 @@ void Resolver::resolveFunc(const Func& f) {
 		}
 		resolve(stmt);
 	}
-	endScope();
+	f.m_scopeSize = endScope();
+	m_functions.pop_back();
 	inFunction = temp;
 	rtrnWarnLine = 0;
 }
@@ -65,7 +125,7 @@ void Resolver::resolveFunc(const Func& f) {
 void Resolver::resolveFunc(const Lambda& f) {
 	bool temp = inFunction;
 	inFunction = true;
-	beginScope();
+	beginFunction(f.m_captures);
 	for (auto& param : f.m_params) {
 		define(param);
 	}
@@ -76,7 +136,8 @@ void Resolver::resolveFunc(const Lambda& f) {
 		}
 		resolve(stmt);
 	}
-	endScope();
+	f.m_scopeSize = endScope();
+	m_functions.pop_back();
 	inFunction = temp;
 	rtrnWarnLine = 0;
 }
@@ -146,7 +207,7 @@ void Resolver::visit(const RangeExpr& range) {
 }
 
 void Resolver::visit(const Variable& var) {
-	resolveLocal(var, var.m_name, true);
+	resolveLocal(var.m_resolved, var.m_name, true);
 }
 
 void Resolver::visit(const Assign& expr) {
@@ -157,7 +218,7 @@ void Resolver::visit(const Assign& expr) {
 		if (isInCurrentScope(expr.m_name.str())) {
 			//! assignment
 			resolve(expr.m_val);
-			resolveLocal(expr, expr.m_name);
+			resolveLocal(expr.m_resolved, expr.m_name);
 			return;
 		}
 		else {
@@ -165,14 +226,14 @@ void Resolver::visit(const Assign& expr) {
 			resolve(expr.m_val);
 			define(expr.m_name);
 			if(!m_scopes.empty())	//ensure we aren't in the global env
-				resolveLocal(expr, expr.m_name);
+				resolveLocal(expr.m_resolved, expr.m_name);
 			return;
 		}
 	}
 
 	if (isStrictAssign) {
 		resolve(expr.m_val);
-		resolveLocal(expr, expr.m_name);
+		resolveLocal(expr.m_resolved, expr.m_name);
 		return;
 	}
 
@@ -219,7 +280,7 @@ void Resolver::visit(const For& stmt) {
 
 	auto temp = inControlFlow;
 	inControlFlow = true;
-	if (auto block = std::dynamic_pointer_cast<Block>(stmt.m_body)) {
+	if (auto block = dynamic_cast<const Block*>(stmt.m_body)) {
 		for (auto& stmt : block->m_stmts) {
 			resolve(stmt);
 		}
@@ -227,7 +288,7 @@ void Resolver::visit(const For& stmt) {
 	else resolve(stmt.m_body);
 	inControlFlow = temp;
 
-	endScope();
+	stmt.m_scopeSize = endScope();
 }
 
 void Resolver::visit(const RangedFor& stmt) {
@@ -239,7 +300,7 @@ void Resolver::visit(const RangedFor& stmt) {
 
 	auto temp2 = inControlFlow;
 	inControlFlow = true;
-	if (auto block = std::dynamic_pointer_cast<Block>(stmt.m_body)) {
+	if (auto block = dynamic_cast<const Block*>(stmt.m_body)) {
 		for (auto& stmt : block->m_stmts) {
 			resolve(stmt);
 		}
@@ -248,11 +309,12 @@ void Resolver::visit(const RangedFor& stmt) {
 	inControlFlow = temp2;
 
 	inRangedFor = temp;
-	endScope();
+	stmt.m_scopeSize = endScope();
 }
 
 void Resolver::visit(const Func& f) {
 	define(f.m_name);
+	resolveLocal(f.m_resolved, f.m_name);
 
 	resolveFunc(f);
 }
@@ -264,6 +326,8 @@ void Resolver::visit(const Return& rtrn) {
 	}
 	if (rtrn.m_val != nullptr) {
 		resolve(rtrn.m_val);
+		//! Nothing is left to do in the function after the call, so the callee can take its frame
+		if (auto call = dynamic_cast<const Call*>(rtrn.m_val)) call->m_isTail = true;
 	}
 	if(!inControlFlow)
 		rtrnWarnLine = rtrn.m_keyword.getLine();
@@ -282,7 +346,7 @@ void Resolver::visit(const Block& block) {
 	for (auto& stmt : block.m_stmts) {
 		resolve(stmt);
 	}
-	endScope();
+	block.m_scopeSize = endScope();
 }
 
 void Resolver::visit(const InExpr& expr) {
@@ -292,6 +356,6 @@ void Resolver::visit(const InExpr& expr) {
 	else {
 		resolve(expr.m_iterable);
 		define(expr.m_name);
-		resolveLocal(expr, expr.m_name);
+		resolveLocal(expr.m_resolved, expr.m_name);
 	}
 }
\ No newline at end of file
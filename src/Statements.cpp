@@ -48,7 +48,7 @@ void RangedFor::accept(StmtVisitor* visitor) const {
 	visitor->visit(*this);
 }
 
-Func::Func(Token name, const std::vector<Token>& params, const Stmts& body) : m_name(name), m_params(params), m_body(body) {
+Func::Func(Token name, const std::vector<Token>& params, const Stmts& body, Arena* unit) : m_name(name), m_params(params), m_body(body), m_unit(unit) {
 
 }
 
@@ -0,0 +1,67 @@
+#include "includes/Stats.hpp"
+
+#ifdef PROTO_STATS
+
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+Stats& Stats::getInstance() {
+	static Stats stats;
+	return stats;
+}
+
+Stats::Timer::Timer(Entry& entry) : m_entry(entry), m_parent(Stats::getInstance().m_current) {
+	Stats::getInstance().m_current = this;
+	m_start = std::chrono::steady_clock::now();
+}
+
+Stats::Timer::~Timer() {
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start);
+	m_entry.m_count++;
+	m_entry.m_self += elapsed - m_nested;
+	if (m_parent) m_parent->m_nested += elapsed;
+	Stats::getInstance().m_current = m_parent;
+}
+
+//! Busiest first, by self time
+static void printEntries(const char* title, std::vector<const Stats::Entry*> entries, std::ostream& out) {
+	if (entries.empty()) return;
+	std::sort(entries.begin(), entries.end(), [](auto a, auto b) { return a->m_self > b->m_self; });
+	std::chrono::nanoseconds total{ 0 };
+	for (auto entry : entries) {
+		total += entry->m_self;
+	}
+
+	out << title << '\n'
+		<< std::setw(14) << "count" << std::setw(12) << "self ms" << std::setw(8) << "self%" << std::setw(10) << "ns/each" << "  name\n";
+	for (auto entry : entries) {
+		auto ns = static_cast<double>(entry->m_self.count());
+		out << std::setw(14) << entry->m_count << std::setw(12) << ns / 1e6 << std::setw(8) << (total.count() ? 100 * ns / total.count() : 0)
+			<< std::setw(10) << ns / entry->m_count << "  " << entry->m_name << '\n';
+	}
+}
+
+void Stats::print(std::ostream& out) const {
+	out << std::fixed << std::setprecision(1) << "[Stats]\n";
+
+	std::vector<const Entry*> visits;
+	for (auto entry = m_visits; entry; entry = entry->m_next) {
+		visits.push_back(entry);
+	}
+	printEntries("Tree walker visits", visits, out);
+
+	std::vector<const Entry*> ops;
+	for (auto& entry : m_ops) {
+		if (entry.m_count) ops.push_back(&entry);
+	}
+	printEntries("VM instructions", ops, out);
+
+	static constexpr const char* names[] = { "strings", "callables", "lists", "environments", "upvalues", "Value copies", "runtime errors" };
+	out << "Events\n";
+	for (std::size_t i = 0; i < static_cast<std::size_t>(Event::COUNT); i++) {
+		out << std::setw(14) << m_events[i] << "  " << names[i] << (i < static_cast<std::size_t>(Event::VALUE_COPIES) ? " created\n" : "\n");
+	}
+}
+
+#endif
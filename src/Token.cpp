@@ -1,6 +1,10 @@
 #include "includes/Token.hpp"
 
 std::string Token::str() const {
+    return std::string(m_lexeme);
+}
+
+std::string_view Token::lexeme() const {
     return m_lexeme;
 }
 
@@ -0,0 +1,754 @@
+#include <algorithm>
+#include <cmath>
+
+#include "includes/VM.hpp"
+#include "includes/Interpreter.hpp"
+#include "includes/ForeignFuncs.hpp"
+#include "includes/GC.hpp"
+#include "includes/Profiler.hpp"
+#include "includes/Stats.hpp"
+#include "proto.hpp"
+
+VM::VM() {
+	m_global = make_obj<Environment>();
+	m_env = m_global;
+
+	Value readfunc = make_obj<Read>();
+	Value printfunc = make_obj<Print>();
+	Value printlnfunc = make_obj<Println>();
+	Value copyfunc = make_obj<Copy>();
+	Value sumfunc = make_obj<Sum>();
+	Value minfunc = make_obj<Min>();
+	Value maxfunc = make_obj<Max>();
+	Value dotfunc = make_obj<Dot>();
+	Value lenfunc = make_obj<Len>();
+	Value containsfunc = make_obj<Contains>();
+	m_global->assign("read", readfunc);
+	m_global->assign("print", printfunc);
+	m_global->assign("println", printlnfunc);
+	m_global->assign("copy", copyfunc);
+	m_global->assign("sum", sumfunc);
+	m_global->assign("min", minfunc);
+	m_global->assign("max", maxfunc);
+	m_global->assign("dot", dotfunc);
+	m_global->assign("len", lenfunc);
+	m_global->assign("contains", containsfunc);
+}
+
+VM& VM::getInstance() {
+	static VM vm;
+	return vm;
+}
+
+Value VM::pop() {
+	auto val = std::move(m_stack.back());
+	m_stack.pop_back();
+	return val;
+}
+
+Value& VM::peek(std::size_t distance) {
+	return m_stack[m_stack.size() - 1 - distance];
+}
+
+Token VM::currentToken() const {
+	auto& frame = m_frames.back();
+	auto& chunk = frame.m_fn->chunk();
+	auto line = chunk.m_lines[frame.m_ip - chunk.m_code.data() - 1];
+	return Token(TokenType::EOF_, "", line, LiteralType::NONE);
+}
+
+void VM::sample() {
+	std::vector<Profiler::Frame> stack;
+	stack.reserve(m_frames.size());
+	for (auto& frame : m_frames) {
+		auto& chunk = frame.m_fn->chunk();
+		auto offset = static_cast<std::size_t>(frame.m_ip - chunk.m_code.data());
+		stack.push_back({ frame.m_fn->m_name, offset ? chunk.m_lines[offset - 1] : 0, frame.m_isTail });
+	}
+	Profiler::getInstance().sample(stack);
+}
+
+RuntimeError VM::error(const std::string& err) const {
+	return RuntimeError(currentToken(), err);
+}
+
+RuntimeError VM::undefined(const Token& name) const {
+	return error("Undefined variable '" + name.str() + "'.");
+}
+
+void VM::pushFrame(CompiledFunction& fn, std::size_t argc) {
+	auto base = m_stack.size() - argc - 1;
+
+	//! The arguments are the first slots of the outermost scope, the rest follow them. Nested
+	//! scopes don't reach past the call either, whatever the function uses from outside is
+	//! global or an upvalue, so they can start from the global environment.
+	m_stack.resize(base + 1 + fn.m_scopeSize, Value::undefined());
+
+	m_frames.push_back({ &fn, fn.chunk().m_code.data(), base, m_env });
+	m_env = m_global;
+}
+
+void VM::replaceFrame(CompiledFunction& fn, std::size_t argc) {
+	auto& frame = m_frames.back();
+	std::move(m_stack.end() - argc - 1, m_stack.end(), m_stack.begin() + frame.m_base);
+	m_stack.resize(frame.m_base + argc + 1);
+	m_stack.resize(frame.m_base + 1 + fn.m_scopeSize, Value::undefined());
+
+	frame.m_fn = &fn;
+	frame.m_ip = fn.chunk().m_code.data();
+	frame.m_isTail = true;
+	m_env = m_global;
+}
+
+Callable* VM::checkCallee(std::size_t argc) {
+	auto& callee = peek(argc);
+
+	if (!callee.isCallable()) {
+		throw error("Provided object is not callable.");
+	}
+
+	auto fn = callee.as<Callable>();
+	if (static_cast<std::size_t>(fn->arity()) != argc) {
+		std::string err = "Expected " + std::to_string(fn->arity()) + " argument(s) but got " + std::to_string(argc) + " argument(s).";
+
+		throw error(err);
+	}
+	return fn;
+}
+
+void VM::callValue(std::size_t argc, bool isTail) {
+	auto fn = checkCallee(argc);
+	invoke(fn, dynamic_cast<CompiledFunction*>(fn), argc, isTail);
+}
+
+//! The callee's cell hasn't been assigned since the call was checked with as many arguments,
+//! so the callee on the stack is still the function that was checked
+void VM::callGlobal(std::size_t argc, GlobalCache& cache, bool isTail) {
+	if (cache.m_callee != nullptr && m_global->version(cache.m_cell) == cache.m_version && cache.m_argc == argc) {
+		invoke(cache.m_callee, cache.m_compiled, argc, isTail);
+		return;
+	}
+
+	auto fn = checkCallee(argc);
+	auto compiled = dynamic_cast<CompiledFunction*>(fn);
+	//! Only if the cell still holds the callee, the arguments could have reassigned it
+	cache.m_callee = nullptr;
+	if (cache.m_cell != GlobalCache::NO_CELL && m_global->cell(cache.m_cell).obj() == fn) {
+		cache.m_version = m_global->version(cache.m_cell);
+		cache.m_callee = fn;
+		cache.m_compiled = compiled;
+		cache.m_argc = argc;
+	}
+	invoke(fn, compiled, argc, isTail);
+}
+
+//! The callee stays on the stack for the duration of the call, which keeps it alive.
+//! A native callee isn't a tail call, the RETURN after it returns its result.
+void VM::invoke(Callable* fn, CompiledFunction* compiled, std::size_t argc, bool isTail) {
+	if (compiled) {
+		if (isTail) {
+			replaceFrame(*compiled, argc);
+			Profiler::getInstance().tailCall();
+		}
+		else pushFrame(*compiled, argc);
+		return;
+	}
+
+	Value result;
+	try {
+		auto args = m_stack.data() + m_stack.size() - argc;
+		result = fn->call(Args(args, args + argc));
+	}
+	catch (const NativeError& err) {
+		throw error(err.what());
+	}
+	m_stack.resize(m_stack.size() - argc - 1);
+	m_stack.push_back(std::move(result));
+}
+
+//! Every frame's scopes are pushed onto the global environment, the script runs in it too
+bool VM::recover(std::size_t exitDepth) {
+	while (m_frames.size() > exitDepth) {
+		auto& frame = m_frames.back();
+		auto& chunk = frame.m_fn->chunk();
+		auto offset = static_cast<std::size_t>(frame.m_ip - chunk.m_code.data()) - 1;
+
+		for (auto& handler : chunk.m_handlers) {
+			if (offset < handler.m_start || offset >= handler.m_end) continue;
+
+			std::size_t depth = 0;
+			for (auto env = m_env.get(); env != m_global.get(); env = env->parentAt(1).get()) {
+				depth++;
+			}
+			m_env = m_env->parentAt(depth - handler.m_scopeDepth);
+			m_stack.resize(frame.m_base + 1 + frame.m_fn->m_scopeSize + handler.m_stackDepth);
+			frame.m_ip = chunk.m_code.data() + handler.m_end;
+			return true;
+		}
+		m_env = frame.m_callerEnv;
+		m_stack.resize(frame.m_base);
+		m_frames.pop_back();
+	}
+	return false;
+}
+
+Value VM::run(std::size_t exitDepth) {
+	while (true) {
+		try {
+			return dispatch(exitDepth);
+		}
+		catch (const RuntimeError& err) {
+			if (!recover(exitDepth)) throw;
+			Proto::getInstance().runtimeError(err);
+		}
+	}
+}
+
+Value VM::dispatch(std::size_t exitDepth) {
+	auto& interpreter = Interpreter::getInstance();
+	Frame* frame = &m_frames.back();
+	const std::uint8_t* ip = frame->m_ip;
+	Chunk* chunk = &frame->m_fn->chunk();
+
+	auto readByte = [&]() { return *ip++; };
+	auto readShort = [&]() { ip += 2; return static_cast<std::size_t>((ip[-2] << 8) | ip[-1]); };
+	auto readName = [&]() -> Token& { return chunk->m_names[readShort()]; };
+	auto readGlobal = [&]() { auto index = readShort(); return std::pair<Token&, GlobalCache&>(chunk->m_names[index], chunk->m_globals[index]); };
+
+	//! Keep the frame's ip in sync so errors and nested calls see the right position
+	auto saveFrame = [&]() { frame->m_ip = ip; };
+	auto loadFrame = [&]() {
+		frame = &m_frames.back();
+		ip = frame->m_ip;
+		chunk = &frame->m_fn->chunk();
+	};
+
+	auto numOperands = [&](const char* err) {
+		if (!interpreter.isNum(peek(0)) || !interpreter.isNum(peek(1))) {
+			saveFrame();
+			throw error(err);
+		}
+		double right = pop().asNum();
+		double left = peek().asNum();
+		return std::make_pair(left, right);
+	};
+	//! Integers are added, subtracted, multiplied and compared without converting to double
+	auto intOperands = [&]() { return peek(0).isInt() && peek(1).isInt(); };
+	auto popInts = [&]() {
+		std::int64_t right = pop().asInt();
+		return std::make_pair(static_cast<std::int64_t>(peek().asInt()), right);
+	};
+	//! Elementwise operators on numeric lists, shared with the tree walker
+	auto listOperands = [&](TokenType op) {
+		if (!interpreter.isList(peek(0)) && !interpreter.isList(peek(1))) return false;
+		saveFrame();
+		auto right = pop();
+		peek() = interpreter.listArithmetic(op, peek(), right, currentToken());
+		return true;
+	};
+
+	while (true) {
+		auto op = static_cast<OpCode>(readByte());
+		PROTO_STATS_OP(op);
+		switch (op) {
+		case OpCode::CONSTANT:
+			m_stack.push_back(chunk->m_constants[readShort()]);
+			break;
+		case OpCode::NIX:
+			m_stack.push_back(nullptr);
+			break;
+		case OpCode::TRUE:
+			m_stack.push_back(true);
+			break;
+		case OpCode::FALSE:
+			m_stack.push_back(false);
+			break;
+		case OpCode::POP:
+			m_stack.pop_back();
+			break;
+
+		case OpCode::GET_LOCAL: {
+			auto& name = readName();
+			auto depth = readShort();
+			auto slot = readShort();
+			saveFrame();
+			try { m_stack.push_back(m_env->getAt(slot, depth, name)); }
+			catch (const RuntimeError&) { throw undefined(name); }
+			break;
+		}
+		case OpCode::SET_LOCAL: {
+			readShort();	//name, only needed for errors
+			auto depth = readShort();
+			auto slot = readShort();
+			m_env->assignAt(slot, peek(), depth);
+			break;
+		}
+		case OpCode::STRICT_SET_LOCAL: {
+			auto& name = readName();
+			auto depth = readShort();
+			auto slot = readShort();
+			saveFrame();
+			try { m_env->strictAssignAt(slot, peek(), depth, name); }
+			catch (const RuntimeError&) { throw undefined(name); }
+			break;
+		}
+		case OpCode::GET_FRAME: {
+			auto& name = readName();
+			auto& val = Upvalue::get(m_stack[frame->m_base + 1 + readShort()]);
+			if (val.isUndefined()) {
+				saveFrame();
+				throw undefined(name);
+			}
+			m_stack.push_back(val);
+			break;
+		}
+		case OpCode::SET_FRAME: {
+			readShort();	//name, only needed for errors
+			Upvalue::get(m_stack[frame->m_base + 1 + readShort()]) = peek();
+			break;
+		}
+		case OpCode::STRICT_SET_FRAME: {
+			auto& name = readName();
+			auto& val = Upvalue::get(m_stack[frame->m_base + 1 + readShort()]);
+			if (val.isUndefined()) {
+				saveFrame();
+				throw undefined(name);
+			}
+			val = peek();
+			break;
+		}
+		case OpCode::GET_UPVALUE:
+		case OpCode::STRICT_SET_UPVALUE: {
+			auto& name = readName();
+			auto& val = frame->m_fn->m_upvalues[readShort()]->m_val;
+			if (val.isUndefined()) {
+				saveFrame();
+				throw undefined(name);
+			}
+			if (op == OpCode::GET_UPVALUE) m_stack.push_back(val);
+			else val = peek();
+			break;
+		}
+		case OpCode::GET_GLOBAL: {
+			auto [name, cache] = readGlobal();
+			saveFrame();
+			try { m_stack.push_back(m_global->get(name, cache)); }
+			catch (const RuntimeError&) { throw undefined(name); }
+			break;
+		}
+		case OpCode::SET_GLOBAL: {
+			auto [name, cache] = readGlobal();
+			m_global->assign(name, peek(), cache);
+			break;
+		}
+		case OpCode::STRICT_SET_GLOBAL: {
+			auto [name, cache] = readGlobal();
+			saveFrame();
+			try { m_global->strictAssign(name, peek(), cache); }
+			catch (const RuntimeError&) { throw undefined(name); }
+			break;
+		}
+		case OpCode::ADD: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = Value::integer(left + right);
+				break;
+			}
+			auto& right = peek(0);
+			auto& left = peek(1);
+			if (interpreter.isNum(left) && interpreter.isNum(right)) {
+				left = left.asNum() + right.asNum();
+			}
+			else if (interpreter.isStr(left) && interpreter.isStr(right)) {
+				left = left.asStr() + right.asStr();
+			}
+			else if (listOperands(TokenType::PLUS)) {
+				break;
+			}
+			else {
+				saveFrame();
+				throw error("Both of the operands must be numbers or strings.");
+			}
+			m_stack.pop_back();
+			break;
+		}
+		case OpCode::SUBTRACT: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = Value::integer(left - right);
+				break;
+			}
+			if (listOperands(TokenType::MINUS)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = left - right;
+			break;
+		}
+		case OpCode::MULTIPLY: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = Value::product(left, right);
+				break;
+			}
+			if (listOperands(TokenType::PRODUCT)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = left * right;
+			break;
+		}
+		case OpCode::DIVIDE: {
+			if (listOperands(TokenType::DIVISON)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			if (interpreter.isEqual(right, 0)) {
+				saveFrame();
+				throw error("Cannot divide by 0!");
+			}
+			peek() = left / right;
+			break;
+		}
+		case OpCode::POWER: {
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = std::pow(left, right);
+			break;
+		}
+		case OpCode::GREATER: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left > right;
+				break;
+			}
+			if (listOperands(TokenType::GREATER)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = !interpreter.isEqual(left, right) && left > right;
+			break;
+		}
+		case OpCode::GT_EQUAL: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left >= right;
+				break;
+			}
+			if (listOperands(TokenType::GT_EQUAL)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = interpreter.isEqual(left, right) || left > right;
+			break;
+		}
+		case OpCode::LESS: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left < right;
+				break;
+			}
+			if (listOperands(TokenType::LESS)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = !interpreter.isEqual(left, right) && left < right;
+			break;
+		}
+		case OpCode::LT_EQUAL: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left <= right;
+				break;
+			}
+			if (listOperands(TokenType::LT_EQUAL)) break;
+			auto [left, right] = numOperands("Operands must be numbers.");
+			peek() = interpreter.isEqual(left, right) || left < right;
+			break;
+		}
+		case OpCode::EQUAL: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left == right;
+				break;
+			}
+			auto right = pop();
+			peek() = interpreter.isEqual(peek(), right);
+			break;
+		}
+		case OpCode::NOT_EQUAL: {
+			if (intOperands()) {
+				auto [left, right] = popInts();
+				peek() = left != right;
+				break;
+			}
+			auto right = pop();
+			peek() = !interpreter.isEqual(peek(), right);
+			break;
+		}
+		case OpCode::NEGATE:
+			if (!interpreter.isNum(peek())) {
+				saveFrame();
+				throw error("Operand must be a number.");
+			}
+			peek() = -peek().asNum();
+			break;
+		case OpCode::NOT:
+			peek() = !interpreter.isTrue(peek());
+			break;
+
+		case OpCode::JUMP: {
+			auto offset = readShort();
+			ip += offset;
+			break;
+		}
+		case OpCode::JUMP_IF_FALSE: {
+			auto offset = readShort();
+			auto& cond = peek();
+			if (cond.isBool() ? !cond.asBool() : !interpreter.isTrue(cond)) ip += offset;
+			m_stack.pop_back();
+			break;
+		}
+		case OpCode::JUMP_IF_TRUE: {
+			auto offset = readShort();
+			auto& cond = peek();
+			if (cond.isBool() ? cond.asBool() : interpreter.isTrue(cond)) ip += offset;
+			m_stack.pop_back();
+			break;
+		}
+		case OpCode::LOOP: {
+			auto offset = readShort();
+			ip -= offset;
+			GC::getInstance().maybeCollect();
+			if (Profiler::getInstance().sampleDue()) {
+				saveFrame();
+				sample();
+			}
+			break;
+		}
+
+		case OpCode::PUSH_SCOPE:
+			m_env = make_obj<Environment>(m_env, readShort());
+			break;
+		case OpCode::POP_SCOPE:
+			m_env = m_env->parentAt(1);
+			break;
+
+		case OpCode::LIST: {
+			auto count = readShort();
+			std::size_t type = 999; //999 == empty list
+			if (count != 0) {
+				type = static_cast<std::size_t>(peek(count - 1).type());
+			}
+			for (std::size_t i = 0; i < count; i++) {
+				if (static_cast<std::size_t>(peek(i).type()) != type) {
+					saveFrame();
+					throw error("Lists are homogenous and can't contain different types.");
+				}
+			}
+			Values values(std::make_move_iterator(m_stack.end() - count), std::make_move_iterator(m_stack.end()));
+			m_stack.resize(m_stack.size() - count);
+			m_stack.push_back(make_obj<list_t>(std::move(values), static_cast<list_t::Type>(type)));
+			break;
+		}
+		case OpCode::RANGE: {
+			bool hasStep = readByte();
+			saveFrame();
+
+			for (std::size_t i = 0; i < (hasStep ? 3 : 2); i++) {
+				if (!interpreter.isNum(peek(i))) {
+					throw error("Ranges can only contain numeric descriptors.");
+				}
+			}
+			double end = pop().asNum();
+			double step = hasStep ? pop().asNum() : 1;
+			double first = pop().asNum();
+			m_stack.push_back(interpreter.makeRange(first, step, end, currentToken()));
+			break;
+		}
+		case OpCode::INDEX: {
+			//! A whole number in range needs none of the checks below
+			if (peek(0).isInt() && peek(1).isList()) {
+				auto list = peek(1).as<list_t>();
+				auto in = peek(0).asInt();
+				if (in >= 1 && static_cast<std::size_t>(in) <= list->size()) {
+					auto element = list->get(in - 1);
+					m_stack.pop_back();
+					peek() = std::move(element);
+					break;
+				}
+			}
+			saveFrame();
+			auto index = pop();
+			if (!interpreter.isList(peek())) {
+				throw error("The index operator can only be used on lists.");
+			}
+			auto list = peek().asRef<list_t>();
+			interpreter.verifyIndices(list.get(), index, currentToken());
+
+			if (interpreter.isList(index)) {
+				peek() = list->gather(*index.as<list_t>());
+			}
+			else {
+				auto in = interpreter.toIndex(index);
+				peek() = list->get(in - 1);
+			}
+			break;
+		}
+		case OpCode::INDEX_ASSIGN: {
+			if (peek(1).isInt() && peek(2).isList()) {
+				auto list = peek(2).as<list_t>();
+				auto in = peek(1).asInt();
+				if (in >= 1 && static_cast<std::size_t>(in) <= list->size() && static_cast<std::size_t>(peek().type()) == static_cast<std::size_t>(list->m_type)) {
+					list->set(in - 1, peek());
+					auto value = pop();
+					m_stack.pop_back();
+					peek() = std::move(value);
+					break;
+				}
+			}
+			saveFrame();
+			auto value = pop();
+			auto index = pop();
+			if (!interpreter.isList(peek())) {
+				throw error("The index operator can only be used on lists.");
+			}
+			auto list = peek().as<list_t>();
+			interpreter.verifyIndices(list, index, currentToken());
+
+			if (interpreter.isList(index)) {
+				auto indexList = index.as<list_t>();
+				if (!interpreter.isList(value)) throw error("The value must be a list.");
+				auto valueList = value.as<list_t>();
+
+				if (indexList->size() != valueList->size()) {
+					throw error("The value list's length must be equal to the number of indices accessed.");
+				}
+				if (!valueList->empty() && list->m_type != valueList->m_type) {
+					throw error("Type mismatch for list assignment.");
+				}
+
+				for (std::size_t i = 0; i < indexList->size(); i++) {
+					auto in = interpreter.toIndex(indexList->get(i));
+					list->set(in - 1, valueList->get(i));
+				}
+			}
+			else {
+				auto in = interpreter.toIndex(index);
+
+				if (static_cast<std::size_t>(value.type()) != static_cast<std::size_t>(list->m_type)) throw error("Type mismatch for list assignment.");
+
+				list->set(in - 1, value);
+			}
+			peek() = value;
+			break;
+		}
+		case OpCode::ITERABLE:
+			if (!interpreter.isList(peek())) {
+				saveFrame();
+				throw error("The specified object for the in-expression isn't an iterable.");
+			}
+			break;
+		case OpCode::FOR_ITER: {
+			readShort();	//name
+			auto depth = readShort();
+			auto slot = readShort();
+			auto exit = readShort();
+
+			auto iterable = peek(1).as<list_t>();
+			auto i = static_cast<std::size_t>(peek(0).asNum());
+
+			if (i >= iterable->size()) {
+				ip += exit;
+				break;
+			}
+			m_env->assignAt(slot, iterable->get(i), depth);
+			peek(0) = static_cast<double>(i + 1);
+			break;
+		}
+
+		case OpCode::CLOSURE: {
+			auto proto = static_cast<CompiledFunction*>(chunk->m_constants[readShort()].as<Callable>());
+			auto fn = make_obj<CompiledFunction>(*proto);
+			fn->m_upvalues = m_env->capture(proto->chunk().m_captures, m_stack.data() + frame->m_base + 1, &frame->m_fn->m_upvalues);
+			m_stack.push_back(fn);
+			break;
+		}
+		case OpCode::CALL:
+		case OpCode::TAIL_CALL: {
+			auto argc = readByte();
+			GC::getInstance().maybeCollect();
+			saveFrame();
+			if (Profiler::getInstance().sampleDue()) sample();
+			callValue(argc, op == OpCode::TAIL_CALL);
+			loadFrame();
+			break;
+		}
+		case OpCode::CALL_GLOBAL:
+		case OpCode::TAIL_CALL_GLOBAL: {
+			auto argc = readByte();
+			auto& cache = chunk->m_globals[readShort()];
+			GC::getInstance().maybeCollect();
+			saveFrame();
+			if (Profiler::getInstance().sampleDue()) sample();
+			callGlobal(argc, cache, op == OpCode::TAIL_CALL_GLOBAL);
+			loadFrame();
+			break;
+		}
+		case OpCode::RETURN: {
+			auto result = pop();
+			m_env = frame->m_callerEnv;
+			m_stack.resize(frame->m_base);
+			m_frames.pop_back();
+
+			if (m_frames.size() == exitDepth) {
+				return result;
+			}
+			m_stack.push_back(std::move(result));
+			loadFrame();
+			break;
+		}
+		}
+	}
+}
+
+Value VM::call(CompiledFunction& fn, Args args) {
+	m_stack.push_back(Callable_ptr(&fn));
+	for (auto& arg : args) {
+		m_stack.push_back(arg);
+	}
+	auto depth = m_frames.size();
+	pushFrame(fn, args.size());
+	return run(depth);
+}
+
+Value VM::execute(obj_ptr<CompiledFunction> script) {
+	auto depth = m_frames.size();
+	auto stackSize = m_stack.size();
+
+	try {
+		//! The script runs directly in the current (global) environment
+		m_stack.push_back(script);
+		m_frames.push_back({ script.get(), script->chunk().m_code.data(), stackSize, m_env });
+		return run(depth);
+	}
+	catch (const RuntimeError&) {
+		//! Unwind everything this script pushed before reporting
+		if (m_frames.size() > depth) {
+			m_env = m_frames[depth].m_callerEnv;
+		}
+		m_frames.resize(depth);
+		m_stack.resize(stackSize);
+		throw;
+	}
+}
+
+void VM::interpret(obj_ptr<CompiledFunction> script) {
+	try {
+		execute(script);
+	}
+	catch (const RuntimeError& err) {
+		Proto::getInstance().runtimeError(err);
+	}
+}
+
+std::string VM::interpret(obj_ptr<CompiledFunction> script, const Expr_ptr& expr) {
+	try {
+		auto val = execute(script);
+		if (!(dynamic_cast<const Call*>(expr) && val.isNix())) {
+			return Interpreter::getInstance().stringify(val, "\"");
+		}
+		else return "";
+	}
+	catch (const RuntimeError& err) {
+		Proto::getInstance().runtimeError(err);
+		return "";
+	}
+}
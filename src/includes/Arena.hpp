@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+//! Owns a compilation unit: its source (a repl line, or a script file mapped into memory),
+//! which tokens point into, the string literals that had to be unescaped, and the AST. The
+//! Parser bump allocates every Expr and Stmt in here, so nodes sit next to each other in
+//! memory and refer to each other by plain pointers. Everything is destroyed together with
+//! the arena, which is when a mapped file gets unmapped.
+//!
+//! Functions keep the arena of their body alive (see Func::m_unit and Chunk::m_unit),
+//! which is what lets a repl line define a function a later line calls.
+class Arena : public std::enable_shared_from_this<Arena> {
+private:
+	static constexpr std::size_t BLOCK_SIZE = 32 * 1024;
+
+	struct Node {
+		void* m_ptr;
+		void (*m_destroy)(void*);
+	};
+
+	std::vector<std::unique_ptr<std::byte[]>> m_blocks;
+	std::byte* m_next = nullptr;
+	std::size_t m_left = 0;
+	std::vector<Node> m_nodes;	//ones that need their destructor run
+
+	std::string m_buffer;
+	std::unique_ptr<MappedFile> m_file;
+	std::string_view m_source;	//in one of the two above, followed by a '\0'
+	std::unordered_set<std::string> m_strings;
+private:
+	void* allocate(std::size_t size, std::size_t align);
+public:
+	Arena(std::string source);
+	Arena(std::unique_ptr<MappedFile> file);
+	Arena(const Arena&) = delete;
+	void operator=(const Arena&) = delete;
+	~Arena();
+
+	std::string_view source() const;
+	//! Keeps str for as long as the unit lives, the same string is only kept once
+	std::string_view intern(std::string str);
+
+	template <typename T, typename... Args>
+	T* make(Args&&... args) {
+		auto node = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			m_nodes.push_back({ node, [](void* ptr) { static_cast<T*>(ptr)->~T(); } });
+		}
+		return node;
+	}
+};
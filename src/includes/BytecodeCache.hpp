@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "CompiledFunc.hpp"
+
+//! Keeps compiled scripts on disk so that running an unchanged file skips lexing, parsing,
+//! resolving and compiling. An entry is named after a hash of the source and keeps a copy
+//! of it. It's only used if that copy matches the source, it was written by the same
+//! executable and a checksum of the entry itself matches. The warnings compiling gave are
+//! stored along, to be shown again when the entry is used.
+//!
+//! Entries go in $PROTO_CACHE_DIR, or proto in the user's cache directory ($XDG_CACHE_HOME,
+//! ~/.cache or %LOCALAPPDATA%). The directory must belong to the user and be writable by
+//! nobody else.
+class BytecodeCache {
+public:
+	using Warnings = std::vector<std::pair<std::size_t, std::string>>;
+private:
+	//! Bump whenever the bytecode (opcodes, operands, what the Compiler emits) or this format changes
+	static constexpr std::uint32_t FORMAT_VERSION = 10;
+
+	std::filesystem::path m_dir;
+	bool m_enabled = true;
+	bool m_dirChecked = false;
+private:
+	BytecodeCache();
+	bool checkDir();	//on first use, turns the cache off if the directory can't be trusted
+	std::filesystem::path entryPath(std::uint64_t hash) const;
+public:
+	static BytecodeCache& getInstance();
+	BytecodeCache(const BytecodeCache&) = delete;
+	void operator=(const BytecodeCache&) = delete;
+
+	void setEnabled(bool val);
+	bool isEnabled() const;
+
+	//! nullptr if there's no valid entry for source
+	obj_ptr<CompiledFunction> load(std::string_view source, Warnings& warnings);
+	void store(std::string_view source, const CompiledFunction& script, const Warnings& warnings);
+};
@@ -1,9 +1,18 @@
 #pragma once
+#include <stdexcept>
+
 #include "Expressions.hpp"
 
-class Callable {
+//! Thrown by native functions. The call site turns it into a RuntimeError at the call's token.
+class NativeError : public std::runtime_error {
+public:
+	using std::runtime_error::runtime_error;
+};
+
+class Callable : public Obj {
 public:
-	virtual Value call(const Values& args) = 0;
+	Callable() : Obj(Obj::Type::CALLABLE) {}
+	virtual Value call(Args args) = 0;
 	virtual int arity() = 0;
 	virtual std::string info() = 0;
 };
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Expressions.hpp"
+#include "Token.hpp"
+#include "Arena.hpp"
+
+//! Operands are either 8 bit (u8) or 16 bit big-endian (u16).
+//! Chunks are cached on disk, see BytecodeCache::FORMAT_VERSION before changing any of this.
+enum class OpCode : std::uint8_t {
+	CONSTANT,			// u16 constant index
+	NIX,
+	TRUE,
+	FALSE,
+	POP,
+
+	GET_LOCAL,			// u16 name index, u16 depth, u16 slot
+	SET_LOCAL,			// u16 name index, u16 depth, u16 slot
+	STRICT_SET_LOCAL,	// u16 name index, u16 depth, u16 slot
+	GET_FRAME,			// u16 name index, u16 slot
+	SET_FRAME,			// u16 name index, u16 slot
+	STRICT_SET_FRAME,	// u16 name index, u16 slot
+	GET_GLOBAL,			// u16 name index
+	SET_GLOBAL,			// u16 name index
+	STRICT_SET_GLOBAL,	// u16 name index
+	GET_UPVALUE,		// u16 name index, u16 upvalue index
+	STRICT_SET_UPVALUE,	// u16 name index, u16 upvalue index
+
+	ADD,
+	SUBTRACT,
+	MULTIPLY,
+	DIVIDE,
+	POWER,
+	GREATER,
+	GT_EQUAL,
+	LESS,
+	LT_EQUAL,
+	EQUAL,
+	NOT_EQUAL,
+	NEGATE,
+	NOT,
+
+	JUMP,				// u16 forward offset
+	JUMP_IF_FALSE,		// u16 forward offset; pops the condition
+	JUMP_IF_TRUE,		// u16 forward offset; pops the condition
+	LOOP,				// u16 backward offset
+
+	PUSH_SCOPE,			// u16 slot count
+	POP_SCOPE,
+
+	LIST,				// u16 element count
+	RANGE,				// u8 has step
+	INDEX,
+	INDEX_ASSIGN,
+	ITERABLE,			// checks that the top of the stack can be iterated over
+	FOR_ITER,			// u16 name index, u16 depth, u16 slot, u16 forward offset to the loop exit
+
+	CLOSURE,			// u16 constant index of the function prototype, captures what its chunk's m_captures lists
+	CALL,				// u8 argument count
+	CALL_GLOBAL,		// u8 argument count, u16 name index of the GET_GLOBAL that pushed the callee
+	TAIL_CALL,			// like CALL, a Proto callee replaces the calling frame
+	TAIL_CALL_GLOBAL,	// like CALL_GLOBAL, a Proto callee replaces the calling frame
+	RETURN
+};
+
+//! The instruction's name, for diagnostics
+const char* opName(OpCode op);
+
+//! A block that catches the runtime errors raised inside it, like Interpreter::executeBlock.
+//! The VM reports the error and resumes at m_end, with the scopes and the stack as they
+//! were around the block's statements.
+struct Handler {
+	std::size_t m_start;
+	std::size_t m_end;
+	std::size_t m_scopeDepth;	//scopes open in the function
+	std::size_t m_stackDepth;	//values kept on the stack by enclosing statements, past the frame's slots
+};
+
+class Chunk {
+public:
+	std::vector<std::uint8_t> m_code;
+	std::vector<std::size_t> m_lines;	//source line for every byte in m_code
+	Values m_constants;
+	std::vector<Token> m_names;			//every identifier once, kept as a token for error reporting
+	std::shared_ptr<Arena> m_unit;		//the source m_names points into
+	std::vector<GlobalCache> m_globals;	//one per name, filled in by the VM as it runs
+	Captures m_captures;				//the upvalues of the function, resolved from where it's created
+	std::vector<Handler> m_handlers;	//innermost first, as their blocks end
+private:
+	//! Only used while compiling, to hand out each name and constant once
+	std::unordered_map<std::string_view, std::size_t> m_nameIndices;
+	std::unordered_map<std::uint64_t, std::size_t> m_numIndices;
+	std::unordered_map<std::string, std::size_t> m_strIndices;
+public:
+	void write(std::uint8_t byte, std::size_t line);
+	void write(OpCode op, std::size_t line);
+	void writeShort(std::size_t val, std::size_t line);
+	//! Numbers and strings that are already in the pool are reused, functions never are
+	std::size_t addConstant(const Value& val);
+	std::size_t addName(const Token& name);
+};
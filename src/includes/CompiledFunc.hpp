@@ -0,0 +1,26 @@
+#pragma once
+#include <memory>
+
+#include "Callable.hpp"
+#include "Chunk.hpp"
+#include "Environment.hpp"
+
+class CompiledFunction : public Callable {
+private:
+	std::string m_name;
+	std::vector<Token> m_params;
+	std::shared_ptr<Chunk> m_chunk;
+	std::size_t m_scopeSize;	//parameters take up the first slots
+	Upvalues m_upvalues;		//set by the VM when the function value is created
+	friend class VM;
+	friend class BytecodeCache;
+	friend class CacheWriter;
+public:
+	CompiledFunction(const std::string& name, const std::vector<Token>& params, std::shared_ptr<Chunk> chunk, std::size_t scopeSize);
+	virtual int arity() override;
+	virtual std::string info() override;
+	virtual Value call(Args args) override;
+	virtual void trace(Tracer& tracer) override;
+	virtual void clearRefs() override;
+	Chunk& chunk();
+};
@@ -0,0 +1,89 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Expressions.hpp"
+#include "Statements.hpp"
+#include "Chunk.hpp"
+#include "CompiledFunc.hpp"
+
+//! Lowers a resolved syntax tree into bytecode for the VM.
+//! Every function body (and the top level script) gets its own chunk.
+class Compiler : public ExprVisitor, public StmtVisitor {
+private:
+	struct Loop {
+		std::size_t scopeDepth = 0;		//scope depth outside the loop body
+		std::size_t continueTarget = 0;	//only valid for backward continues
+		bool forwardContinue = false;	//a for loop continues to its increment clause, which comes later
+		std::vector<std::size_t> breakJumps;
+		std::vector<std::size_t> continueJumps;
+	};
+
+	std::shared_ptr<Arena> m_unit;
+	std::shared_ptr<Chunk> m_chunk;
+	std::size_t m_line = 0;
+	std::size_t m_scopeDepth = 0;
+	std::size_t m_stackDepth = 0;	//values ranged for loops keep on the stack, see Handler
+	std::vector<Loop> m_loops;
+	const char* m_limit = nullptr;	//the first limit of the bytecode the script goes over
+	std::size_t m_limitLine = 0;
+
+private:
+	void overLimit(const char* limit);
+	Chunk& chunk();
+	void emit(OpCode op);
+	void emit(std::uint8_t byte);
+	void emitShort(std::size_t val);
+	void emitConstant(const Value& val);
+	std::size_t emitName(OpCode op, const Token& name);	//returns the name's index
+	std::size_t emitVariable(OpCode localOp, OpCode globalOp, const Resolution& resolved, const Token& name);	//returns the name's index too
+	std::size_t emitJump(OpCode op);
+	void patchJump(std::size_t offset);
+	void emitLoop(std::size_t start);
+	void beginScope(std::size_t scopeSize);
+	void endScope(std::size_t scopeSize);
+	void emitScopeExits(std::size_t depth);
+
+	void compile(const Stmt_ptr& stmt);
+	void compile(const Expr_ptr& expr);
+	void compileLoopBody(const Stmt_ptr& body);
+	//! Statements that report their runtime errors and carry on after themselves
+	void compileHandled(const Stmts& stmts);
+	obj_ptr<CompiledFunction> compileFunction(const std::string& name, const std::vector<Token>& params, const Stmts& body, std::size_t scopeSize, const Captures& captures);
+
+public:
+	Compiler(std::shared_ptr<Arena> unit);
+	//! The script returns nix, an expression script (for the repl) returns its value.
+	//! nullptr if the script goes over a limit of the bytecode (u16 operands), which the
+	//! tree walker doesn't have.
+	obj_ptr<CompiledFunction> compileScript(const Stmts& stmts);
+	obj_ptr<CompiledFunction> compileScript(const Expr_ptr& expr);
+	const char* limit() const;		//what compileScript went over, nullptr if nothing
+	std::size_t limitLine() const;
+
+	virtual void visit(const Binary& bin) override;
+	virtual void visit(const Unary& un) override;
+	virtual void visit(const ParenGroup& group) override;
+	virtual void visit(const Literal& lit) override;
+	virtual void visit(const Variable& var) override;
+	virtual void visit(const Logical& log) override;
+	virtual void visit(const Assign& expr) override;
+	virtual void visit(const Call& expr) override;
+	virtual void visit(const Lambda& expr) override;
+	virtual void visit(const ListExpr& expr) override;
+	virtual void visit(const Index& expr) override;
+	virtual void visit(const RangeExpr& expr) override;
+	virtual void visit(const IndexAssign& expr) override;
+	virtual void visit(const InExpr& expr) override;
+
+	virtual void visit(const Expression& expr) override;
+	virtual void visit(const Block& block) override;
+	virtual void visit(const If& ifStmt) override;
+	virtual void visit(const While& whilestmt) override;
+	virtual void visit(const For& forstmt) override;
+	virtual void visit(const RangedFor& rforstmt) override;
+	virtual void visit(const Break& breakstmt) override;
+	virtual void visit(const Continue& contstmt) override;
+	virtual void visit(const Func& func) override;
+	virtual void visit(const Return& stmt) override;
+};
@@ -1,28 +1,79 @@
 #pragma once
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "Token.hpp"
 #include "Expressions.hpp"
 
 class Environment;
-using Env_ptr = std::shared_ptr<Environment>;
+using Env_ptr = obj_ptr<Environment>;
 
-class Environment : public std::enable_shared_from_this<Environment>{
+//! A local captured by a closure. Capturing moves the variable's value into an Upvalue that
+//! takes its place in the slot, so the frame and every closure capturing the variable share
+//! it, and a closure keeps only the variables it uses alive. Reading or assigning a slot
+//! goes through the Upvalue once there is one.
+class Upvalue : public Obj {
+public:
+	Value m_val;
+public:
+	Upvalue(Value val) : Obj(Obj::Type::UPVALUE), m_val(std::move(val)) {}
+	virtual void trace(Tracer& tracer) override {
+		if (auto obj = m_val.obj()) tracer.visit(obj);
+	}
+	virtual void clearRefs() override {
+		m_val = nullptr;
+	}
+
+	//! The variable in a slot of an environment or a call frame
+	static Value& get(Value& slot) {
+		return slot.isUpvalue() ? slot.as<Upvalue>()->m_val : slot;
+	}
+	//! Boxes the slot unless that already happened
+	static obj_ptr<Upvalue> capture(Value& slot);
+};
+using Upvalue_ptr = obj_ptr<Upvalue>;
+using Upvalues = std::vector<Upvalue_ptr>;
+
+//! The global scope is keyed by name since globals can be created at any point (the repl
+//! for instance). Local scopes are flat frames indexed by the slots the Resolver hands out.
+//!
+//! The global scope keeps its values in m_slots as well, each name mapping to a cell that
+//! stays put once created. GlobalCaches hold on to those cells (see GlobalCache).
+class Environment : public Obj {
 private:
-	std::unordered_map<std::string, Value> m_vars;
+	std::unordered_map<std::string, std::size_t> m_vars;	//global name to cell
+	Values m_slots;	//undefined until the variable is first assigned
+	std::vector<std::uint64_t> m_versions;	//per global cell, bumped on every assignment
 	Env_ptr m_parent; //enclosing scope
 private:
-	Env_ptr getSharedPtr();
+	Environment* ancestor(std::size_t dist);
+	std::size_t findCell(const Token& name);	//throws if the global doesn't exist
+	void assignCell(std::size_t cell, const Value& val);
 public:
-	Value& get(Token name);
-	Value& getAt(Token name, std::size_t dist);
+	Value& get(const Token& name);
 	Env_ptr parentAt(std::size_t distance);
-	bool isDefined(const std::string& name) const;
 	void assign(const std::string& name, const Value& val);
-	void assignAt(const std::string& name, const Value& val, std::size_t dist);
-	void strictAssign(Token name, const Value& val);
-	void strictAssignAt(Token name, const Value& val, std::size_t dist);
+	void strictAssign(const Token& name, const Value& val);
+
+	//! Global scope through a site's cache
+	Value& get(const Token& name, GlobalCache& cache);
+	void assign(const Token& name, const Value& val, GlobalCache& cache);
+	void strictAssign(const Token& name, const Value& val, GlobalCache& cache);
+	const Value& cell(std::size_t cell) const;
+	std::uint64_t version(std::size_t cell) const;
+
+	Value& getAt(std::size_t slot, std::size_t dist, const Token& name);
+	void assignAt(std::size_t slot, const Value& val, std::size_t dist);
+	void strictAssignAt(std::size_t slot, const Value& val, std::size_t dist, const Token& name);
+	//! Captures a local, the slot may not have been assigned yet
+	Upvalue_ptr upvalueAt(std::size_t slot, std::size_t dist);
+	//! What the Resolutions in captures refer to from this environment and the running call's
+	//! frame and upvalues, both of which are null at the top level
+	Upvalues capture(const Captures& captures, Value* frame, const Upvalues* enclosing);
 	Environment();
-	Environment(Env_ptr env);
+	Environment(Env_ptr env, std::size_t slots);
+
+	virtual void trace(Tracer& tracer) override;
+	virtual void clearRefs() override;
 };
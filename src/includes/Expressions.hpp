@@ -1,5 +1,5 @@
 #pragma once
-#include <variant>
+#include <deque>
 #include <vector>
 #include <sstream>
 #include <string>
@@ -10,6 +10,8 @@
 #include <iomanip>
 
 #include "Token.hpp"
+#include "Value.hpp"
+#include "List.hpp"
 
 class Binary;
 class Unary;
@@ -45,12 +47,50 @@ public:
 	virtual void visit(const InExpr&) = 0;
 };
 
+//! Where the Resolver found a variable. Unresolved names are looked up in the global scope.
+//! A local of an enclosing function is reached through one of the current function's
+//! upvalues instead, since the function doesn't keep the environment it was defined in.
+//! The outermost scope of a function isn't an environment either, its slots are the call's
+//! frame on the value stack, starting with the arguments.
+struct Resolution {
+	bool m_isLocal = false;
+	std::size_t m_depth = 0;	//number of scopes to walk up
+	std::size_t m_slot = 0;		//index into that scope's frame, or into the upvalues
+	bool m_isUpvalue = false;
+	bool m_inFrame = false;		//in the function's outermost scope, m_depth doesn't apply
+};
+
+//! The variables a function captures when it's created, in upvalue order. Each is resolved
+//! from where the function is defined: a local there, or an upvalue of the enclosing function.
+//! A deque so the Resolver can keep pointers to the elements while adding more.
+using Captures = std::deque<Resolution>;
+
+class Callable;
+class CompiledFunction;
+class ProtoFunction;
+
+//! Inline cache for a global reference. Globals live in numbered cells that are never removed,
+//! so once a name has been found its cell is used directly instead of hashing the name.
+//! Every assignment to a cell bumps its version. A call site also remembers the callee it
+//! checked (callable, right arity), which stays valid as long as the version is unchanged.
+//! The VM shares one cache between the sites of a name, so it also keeps the argument count.
+struct GlobalCache {
+	static constexpr std::size_t NO_CELL = static_cast<std::size_t>(-1);
+	std::size_t m_cell = NO_CELL;
+	std::uint64_t m_version = 0;
+	Callable* m_callee = nullptr;			//only valid at m_version, then the cell holds it
+	CompiledFunction* m_compiled = nullptr;	//m_callee if the VM can run it directly
+	ProtoFunction* m_proto = nullptr;		//m_callee if the tree walker can run it in place
+	std::size_t m_argc = 0;					//what m_callee was checked with by the VM
+};
+
 class Expr {
 public:
 	virtual void accept(ExprVisitor* visitor) const = 0;
 };
 
-using Expr_ptr = std::shared_ptr<Expr>;
+//! Nodes are owned by the Arena of their compilation unit
+using Expr_ptr = const Expr*;
 
 class Binary : public Expr {
 public:
@@ -80,46 +120,24 @@ public:
 	virtual void accept(ExprVisitor* visitor) const override;
 };
 
-class Callable;
-using Callable_ptr = std::shared_ptr<Callable>;
-
-class list_t;
-using list_ptr = std::shared_ptr<list_t>;
-using Value = std::variant<std::string, long double, std::nullptr_t, bool, Callable_ptr, list_ptr>;
-using Values = std::vector<Value>;
-
-class list_t {
-public:
-	Values m_list;
-	//the types in here align with the order of the types in Value
-	enum class Type : std::size_t {
-		strList = 0,
-		numList,
-		nixList,
-		boolList,
-		fnList,
-		multidimList,
-		emptyList = 999
-	};
-	Type m_type;
-public:
-	list_t(const Values& list, Type type) : m_list(list), m_type(type) {
-
-	}
-};
+using Callable_ptr = obj_ptr<Callable>;
 
 class Literal : public Expr {
 public:
 	Value m_val;
 	LiteralType m_literalType;
+	std::size_t m_line;
 public:
 	Literal(Token literal);
+	Literal(const Value& val, std::size_t line);	//a value the Optimizer computed
 	virtual void accept(ExprVisitor* visitor) const override;
 };
 
 class Variable : public Expr {
 public:
 	Token m_name;
+	mutable Resolution m_resolved;
+	mutable GlobalCache m_global;
 public:
 	Variable(Token name);
 	virtual void accept(ExprVisitor* visitor) const override;
@@ -140,6 +158,8 @@ public:
 	Token m_name;
 	Token m_op;
 	Expr_ptr m_val;
+	mutable Resolution m_resolved;
+	mutable GlobalCache m_global;
 public:
 	Assign(Token name, Token op, Expr_ptr val);
 	virtual void accept(ExprVisitor* visitor) const override;
@@ -150,6 +170,8 @@ public:
 	Expr_ptr m_callee;
 	Token m_paren;	//rparen to keep track of call line
 	std::vector<Expr_ptr> m_args;
+	mutable GlobalCache m_global;	//for a callee that's a global variable
+	mutable bool m_isTail = false;	//set by the Resolver if it's the value of a return statement
 public:
 	Call(Expr_ptr callee, Token rparen, const std::vector<Expr_ptr>& args);
 	virtual void accept(ExprVisitor* visitor) const override;
@@ -203,10 +225,11 @@ public:
 	Token m_name;
 	Token m_inKeyword;
 	Expr_ptr m_iterable;
+	mutable Resolution m_resolved;
 public:
 	InExpr(Token name, Token in, Expr_ptr iterable);
 	virtual void accept(ExprVisitor* visitor) const override;
 };
 
-const auto epsilon = std::numeric_limits<long double>::epsilon();
-const auto maxPrecision = std::numeric_limits<long double>::digits10 + 1;
\ No newline at end of file
+const auto epsilon = std::numeric_limits<double>::epsilon();
+const auto maxPrecision = std::numeric_limits<double>::digits10 + 1;
\ No newline at end of file
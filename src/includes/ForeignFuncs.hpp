@@ -2,6 +2,7 @@
 #include <iostream>
 
 #include "Callable.hpp"
+#include "Kernels.hpp"
 
 class Read : public Callable {
 public:
@@ -11,7 +12,7 @@ public:
 	virtual std::string info() override {
 		return "<Proto::generic::foreignfn read>";
 	}
-	virtual Value call(const Values& args) override {
+	virtual Value call(Args args) override {
 		std::string str;
 		std::getline(std::cin, str);
 		return str;
@@ -26,7 +27,7 @@ public:
 	virtual std::string info() {
 		return "<Proto::generic::foreignfn print>";
 	}
-	virtual Value call(const Values& args) override {
+	virtual Value call(Args args) override {
 		std::cout << std::setprecision(maxPrecision) << Interpreter::getInstance().stringify(args.at(0));
 		return nullptr;
 	}
@@ -40,7 +41,7 @@ public:
 	virtual std::string info() {
 		return "<Proto::generic::foreignfn println>";
 	}
-	virtual Value call(const Values& args) override {
+	virtual Value call(Args args) override {
 		std::cout << std::setprecision(maxPrecision) << Interpreter::getInstance().stringify(args.at(0)) << '\n';
 		return nullptr;
 	}
@@ -53,12 +54,115 @@ class Copy : public Callable {
 	virtual std::string info() {
 		return "<Proto::generic::foreignfn copy>";
 	}
-	virtual Value call(const Values& args) override {
+	virtual Value call(Args args) override {
 		const Value& val = args.at(0);
 		
-		if (!std::holds_alternative<list_ptr>(val)) return val;
+		if (!val.isList()) return val;
 
-		auto& list = std::get<list_ptr>(val);
-		return std::make_shared<list_t>(list->m_list, list->m_type);
+		auto list = val.as<list_t>();
+		return make_obj<list_t>(*list);
 	}
-};
\ No newline at end of file
+};
+
+//! Returns a list argument, or throws if it isn't a list of numbers
+inline const list_t* numericList(const Value& val, const char* fn) {
+	if (val.isList()) {
+		auto list = val.as<list_t>();
+		if (list->m_type == list_t::Type::numList || list->m_type == list_t::Type::emptyList) return list;
+	}
+	throw NativeError(std::string(fn) + " expects a list of numbers.");
+}
+
+class Sum : public Callable {
+	virtual int arity() override {
+		return 1;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn sum>";
+	}
+	virtual Value call(Args args) override {
+		auto list = numericList(args.at(0), "sum");
+		return Kernels::getInstance().sum(list->numData(), list->size());
+	}
+};
+
+class Min : public Callable {
+	virtual int arity() override {
+		return 1;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn min>";
+	}
+	virtual Value call(Args args) override {
+		auto list = numericList(args.at(0), "min");
+		if (list->empty()) throw NativeError("min of an empty list.");
+		return Kernels::getInstance().min(list->numData(), list->size());
+	}
+};
+
+class Max : public Callable {
+	virtual int arity() override {
+		return 1;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn max>";
+	}
+	virtual Value call(Args args) override {
+		auto list = numericList(args.at(0), "max");
+		if (list->empty()) throw NativeError("max of an empty list.");
+		return Kernels::getInstance().max(list->numData(), list->size());
+	}
+};
+
+class Dot : public Callable {
+	virtual int arity() override {
+		return 2;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn dot>";
+	}
+	virtual Value call(Args args) override {
+		auto left = numericList(args.at(0), "dot");
+		auto right = numericList(args.at(1), "dot");
+		if (left->size() != right->size()) throw NativeError("dot expects lists of the same length.");
+		return Kernels::getInstance().dot(left->numData(), right->numData(), left->size());
+	}
+};
+
+class Len : public Callable {
+	virtual int arity() override {
+		return 1;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn len>";
+	}
+	virtual Value call(Args args) override {
+		const Value& val = args.at(0);
+		if (val.isList()) return static_cast<double>(val.as<list_t>()->size());
+		if (val.isStr()) return static_cast<double>(val.asStr().size());
+		throw NativeError("len expects a list or a string.");
+	}
+};
+
+class Contains : public Callable {
+	virtual int arity() override {
+		return 2;
+	}
+	virtual std::string info() {
+		return "<Proto::generic::foreignfn contains>";
+	}
+	virtual Value call(Args args) override {
+		if (!args.at(0).isList()) throw NativeError("contains expects a list as its first argument.");
+		auto list = args.at(0).as<list_t>();
+		const Value& val = args.at(1);
+
+		if (list->m_type == list_t::Type::numList) {
+			return val.isNum() && list->contains(val.asNum());
+		}
+		auto& interpreter = Interpreter::getInstance();
+		for (std::size_t i = 0; i < list->size(); i++) {
+			if (interpreter.isEqual(list->get(i), val)) return true;
+		}
+		return false;
+	}
+};
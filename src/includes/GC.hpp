@@ -0,0 +1,64 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+
+#include "Value.hpp"
+
+//! Reference counting frees most objects as soon as they're unused, but never frees cycles:
+//! a function stored in the environment it closes over, or a list holding a lambda that
+//! refers back to the list. The collector finds those.
+//!
+//! Collection is mark-sweep over the tracked objects (everything but strings). The roots
+//! are the objects referenced from outside the tracked heap: the VM stack, m_global, the
+//! active environments and whatever the tree walker holds in C++ locals. They are found by
+//! subtracting the references tracked objects hold to each other from the refcounts, so no
+//! root can be missed. Unmarked objects get their references cleared, which lets
+//! refcounting free them.
+//!
+//! New objects start out young. A young collection only looks at those, counting references
+//! from old objects as roots, and promotes the survivors. Every m_fullEvery-th collection
+//! looks at everything.
+//!
+//! Collections only happen at safe points (between statements in the tree walker, on
+//! calls and backward jumps in the VM), never while an object is being constructed.
+class GC {
+private:
+	Obj* m_youngGen = nullptr;	//intrusive lists through Obj::m_gcPrev/m_gcNext
+	Obj* m_oldGen = nullptr;
+	std::size_t m_youngCount = 0;
+	std::size_t m_oldCount = 0;
+
+	std::size_t m_threshold = 10000;	//young objects that trigger a collection
+	std::size_t m_fullEvery = 10;
+	std::size_t m_sinceFull = 0;
+
+	//! Pause statistics
+	std::size_t m_collections = 0;
+	std::size_t m_fullCollections = 0;
+	std::size_t m_freed = 0;
+	double m_totalPause = 0;	//milliseconds
+	double m_maxPause = 0;
+
+	//! The collector only holds plain data, so it stays usable while other singletons
+	//! release their objects during static destruction
+	GC() = default;
+private:
+	void link(Obj*& head, Obj* obj);
+	void unlink(Obj*& head, Obj* obj);
+public:
+	static GC& getInstance();
+	GC(const GC&) = delete;
+	void operator=(const GC&) = delete;
+
+	void track(Obj* obj);
+	void untrack(Obj* obj);
+
+	//! Called at safe points, collects once enough young objects piled up
+	void maybeCollect() {
+		if (m_youngCount >= m_threshold) collect(++m_sinceFull >= m_fullEvery);
+	}
+	void collect(bool full);
+
+	void setThreshold(std::size_t threshold);
+	void printStats(std::ostream& out) const;
+};
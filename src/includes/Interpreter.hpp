@@ -1,9 +1,12 @@
 #pragma once
+#include <cmath>
+
 #include "Expressions.hpp"
 #include "Statements.hpp"
 #include "Environment.hpp"
 #include "Callable.hpp"
 #include "ProtoFunc.hpp"
+#include "Profiler.hpp"
 
 class RuntimeError : std::exception {
 private:
@@ -16,15 +19,28 @@ public:
 	Token getToken() const;
 };
 
-class BreakThrow {};
-class ContinueThrow {};
-
 class Interpreter : public ExprVisitor, public StmtVisitor {
 private:
+	//! How the last statement finished. break, continue and return unwind through
+	//! blocks and loops by checking this instead of throwing.
+	enum class Completion {
+		NORMAL,
+		BREAK,
+		CONTINUE,
+		RETURN
+	};
+
 	Value m_val;
+	Completion m_completion = Completion::NORMAL;
 	Env_ptr m_env;	//the current environment
 	Env_ptr m_global;	//the global environment of course
-	std::unordered_map<const Expr*, std::size_t> m_locals;
+	const Upvalues* m_upvalues = nullptr;	//the running function's
+	//! The slots of every active call's outermost scope, the arguments of a call are
+	//! evaluated straight into the callee's
+	Values m_stack;
+	std::size_t m_frame = 0;	//where the running call's slots start in m_stack
+	obj_ptr<ProtoFunction> m_tailCall;	//set by a return's tail call, whose arguments are on top of m_stack
+	std::vector<Profiler::Frame> m_calls;	//the script and every active call, with the line each is on
 private:
 	bool isNum(const Value& val);
 	bool isNix(const Value& val);
@@ -33,22 +49,39 @@ private:
 	bool isTrue(const Value& val);
 	bool isCallable(const Value& val);
 	bool isList(const Value& val);
-	bool isEqual(const Value& left, const Value& right);
-	bool isEqual(long double left, long double right);
+	bool isEqual(double left, double right);
 
-	void execute(Stmt_ptr stmt);
-	void executeBlock(Stmts stmts, Env_ptr env);
+	Completion execute(Stmt_ptr stmt);
+	bool exitsLoop();	//consumes a break or continue, true if the loop has to stop
+	void executeBlock(const Stmts& stmts, Env_ptr env);
 
-	Value& lookUpVariable(const Expr& e, const Token& t);
+	Value& lookUpVariable(const Resolution& resolved, GlobalCache& cache, const Token& t);
+	Value& lookUpUpvalue(std::size_t index, const Token& t);
+	Value& lookUpFrame(std::size_t slot, const Token& t);
+	void assignVariable(const Resolution& resolved, GlobalCache& cache, const Token& t, const Value& val, bool isStrict);
 
-	void verifyIndices(list_ptr list, const Value& index, Token indexOp);
+	void verifyIndices(const list_t* list, const Value& index, const Token& indexOp);
+	//! The 1 based position a verified index refers to
+	static std::size_t toIndex(const Value& index) {
+		return index.isInt() ? index.asInt() : std::lround(index.asNum());
+	}
+	//! Arithmetic and comparisons on two integers, false for the operators that need doubles
+	bool intBinary(TokenType op, std::int64_t left, std::int64_t right);
+	//! Elementwise arithmetic and comparisons where at least one operand is a numeric list
+	Value listArithmetic(TokenType op, const Value& left, const Value& right, const Token& opTok);
+	//! Builds first..step..end. Integral ranges are lazy, fractional ones are filled the way
+	//! repeatedly adding the step would.
+	Value makeRange(double first, double step, double end, const Token& rangeOp);
 
 	Interpreter();
 	friend ProtoFunction;
+	friend class VM;
+	friend class Compiler;
+	friend class Optimizer;
 public:
 	static Interpreter& getInstance();
 	std::string stringify(const Value& value, const char* strContainer = "");
-	void resolve(const Expr& expr, std::size_t depth);
+	bool isEqual(const Value& left, const Value& right);
 	Interpreter(const Interpreter&) = delete;
 	void operator=(const Interpreter&) = delete;
 	
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//! Elementwise and reduction kernels over contiguous doubles, used by numeric lists.
+//! The widest instruction set the CPU supports (AVX2, SSE2 or plain scalar code) is picked
+//! once at startup. Reductions accumulate in four lanes on every path, so sums don't
+//! change with the instruction set.
+class Kernels {
+public:
+	enum class Op {
+		ADD,
+		SUB,
+		MUL,
+		DIV
+	};
+	enum class Cmp {
+		GREATER,
+		GT_EQUAL,
+		LESS,
+		LT_EQUAL
+	};
+	enum class Isa {
+		SCALAR,
+		SSE2,
+		AVX2
+	};
+private:
+	Isa m_isa;
+	Kernels();
+public:
+	static Kernels& getInstance();
+	Kernels(const Kernels&) = delete;
+	void operator=(const Kernels&) = delete;
+
+	Isa isa() const;
+
+	//! out[i] = a[i] op b[i]
+	void arith(Op op, const double* a, const double* b, double* out, std::size_t n) const;
+	//! out[i] = a[i] op b, or b op a[i] if scalarLeft is set
+	void arith(Op op, const double* a, double b, bool scalarLeft, double* out, std::size_t n) const;
+	//! out[i] = a[i] cmp b[i] as 0 or 1. Values closer than epsilon compare equal.
+	void compare(Cmp cmp, const double* a, const double* b, std::uint8_t* out, std::size_t n) const;
+	//! out[i] = a[i] cmp b as 0 or 1
+	void compare(Cmp cmp, const double* a, double b, std::uint8_t* out, std::size_t n) const;
+
+	double sum(const double* a, std::size_t n) const;
+	double dot(const double* a, const double* b, std::size_t n) const;
+	//! n must not be 0
+	double min(const double* a, std::size_t n) const;
+	double max(const double* a, std::size_t n) const;
+};
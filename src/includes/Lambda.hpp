@@ -2,12 +2,17 @@
 #include "Statements.hpp"
 #include "Expressions.hpp"
 
+class Arena;
+
 class Lambda : public Expr {
 public:
 	std::vector<Token> m_params;
 	Stmts m_body;
+	mutable std::size_t m_scopeSize = 0;
+	mutable Captures m_captures;	//set by the Resolver
+	Arena* m_unit;	//owns the body
 public:
-	Lambda(const std::vector<Token>& params, const Stmts& body) : m_params(params), m_body(body) {
+	Lambda(const std::vector<Token>& params, const Stmts& body, Arena* unit) : m_params(params), m_body(body), m_unit(unit) {
 
 	}
 	virtual void accept(ExprVisitor* visitor) const override {
@@ -1,26 +1,34 @@
 #pragma once
 #include "Token.hpp"
+#include "Arena.hpp"
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class Proto;
 
 class Lexer {
 private:
-    std::string m_src;
+    Arena& m_unit;
+    std::string_view m_src;     //owned by m_unit, which keeps a '\0' right after it
     std::vector<Token> m_tokens;
-    std::size_t m_start;    //position of the first character in the current lexeme
-    std::size_t m_current;  //position of the character being scanned
+    const char* m_start;    //the first character in the current lexeme
+    const char* m_current;  //the character being scanned
+    const char* m_end;
     std::size_t m_line;     //line we're currently at
 private:
     bool isAtEnd() const;
     void scanToken(Proto& p);
     char advance();
     void addToken(TokenType type, LiteralType ltype = LiteralType::NONE);
+    std::string unescape(std::string_view str, Proto& p) const;
+    void appendUtf8(std::string& out, std::uint32_t code) const;
     // Is the next character equal to c? If yes, consume
     bool isNext(char c);
     bool isDigit(char c) const;
+    int hexValue(char c) const; //-1 if c isn't a hex digit
     bool isAlphaOrUnderscore(char c) const;
     bool isAlphaNumeric(char c) const;
     char peek() const;
@@ -28,8 +36,9 @@ private:
     void string(Proto& p);
     void number(Proto& p);
     void identifierOrKeyword();
+    void skipWhitespace();
 public:
     Lexer() = delete;
-    Lexer(std::string&& src) : m_src(std::move(src)), m_start(0), m_current(0), m_line(1) {}
+    Lexer(Arena& unit) : m_unit(unit), m_src(unit.source()), m_start(m_src.data()), m_current(m_src.data()), m_end(m_src.data() + m_src.size()), m_line(1) {}
     std::vector<Token>& scanTokens(Proto& p);
 };
\ No newline at end of file
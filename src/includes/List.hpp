@@ -0,0 +1,69 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Value.hpp"
+
+class list_t;
+using list_ptr = obj_ptr<list_t>;
+
+//! Lists are homogenous, so the backing store is picked by the element type: numbers are
+//! kept as contiguous doubles, booleans as packed bits and everything else as Values.
+//! Buffers are shared by copies and slices and only copied on the first write to a shared
+//! one, a list seeing m_length elements of its buffer starting at m_offset.
+//! Integral ranges only keep their first element and step until the numbers are needed as
+//! a whole (for a mutation or a kernel).
+class list_t : public Obj {
+public:
+	//the types in here align with the order of ValueType
+	enum class Type : std::size_t {
+		strList = 0,
+		numList,
+		nixList,
+		boolList,
+		fnList,
+		multidimList,
+		emptyList = 999
+	};
+	Type m_type;
+private:
+	mutable std::shared_ptr<std::vector<double>> m_nums;	//numList
+	std::shared_ptr<std::vector<bool>> m_bools;				//boolList
+	std::shared_ptr<Values> m_vals;							//every other type
+	std::size_t m_offset = 0;
+	std::size_t m_length = 0;
+
+	mutable bool m_lazy = false;	//a range that hasn't been materialized into m_nums
+	double m_first = 0;
+	double m_step = 0;
+private:
+	void materialize() const;
+	void detach();	//gives this list a buffer of its own before a write
+	list_ptr slice(std::size_t start, std::size_t length) const;
+public:
+	list_t(Values&& list, Type type);
+	list_t(const Values& list, Type type);
+	list_t(std::vector<double>&& nums);
+	list_t(std::vector<bool>&& bools);
+	//! A lazy range of count numbers: first, first + step, ...
+	list_t(double first, double step, std::size_t count);
+
+	std::size_t size() const;
+	bool empty() const;
+	Value get(std::size_t i) const;	//0 based, unchecked
+	void set(std::size_t i, const Value& val);
+
+	//! Builds a new list from the (1 based, already verified) indices in a numList.
+	//! A contiguous range of indices gives a slice sharing this list's buffer.
+	list_ptr gather(const list_t& indices) const;
+	//! Only valid for numList. Lazy ranges answer without materializing.
+	bool contains(double num) const;
+	//! Lazy ranges are always integral and ascending
+	bool isLazy() const;
+
+	//! The size() numbers of a numList (or emptyList), materializing a lazy range
+	const double* numData() const;
+
+	virtual void trace(Tracer& tracer) override;
+	virtual void clearRefs() override;
+};
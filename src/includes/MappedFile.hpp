@@ -0,0 +1,24 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+//! A read-only view of a whole file. The file is mapped into memory where the platform
+//! supports it and read into a buffer otherwise. Either way the data is followed by a '\0',
+//! so it can be scanned like a std::string.
+class MappedFile {
+private:
+	const char* m_data = nullptr;
+	std::size_t m_size = 0;
+	bool m_open = false;
+	bool m_mapped = false;
+	std::string m_buffer;	//backs m_data when the file couldn't be mapped
+public:
+	MappedFile(const std::string& path);
+	MappedFile(const MappedFile&) = delete;
+	void operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	bool isOpen() const;
+	std::string_view view() const;
+};
@@ -0,0 +1,69 @@
+#pragma once
+#include "Expressions.hpp"
+#include "Statements.hpp"
+
+class Arena;
+
+//! Simplifies a resolved syntax tree before it's run or compiled, so both backends benefit.
+//!
+//! Subtrees made only of literals are evaluated once (with the Interpreter, so the results
+//! are exactly what running them would give) and replaced by a Literal. A subtree whose
+//! evaluation throws, like 1 / 0 or "a" - 1, is left alone so the error still happens when,
+//! and only if, it runs.
+//!
+//! Identities (x * 1, x / 1, x ^ 1, x - 0, -(-x), !(!x)) are only simplified where x is known
+//! to be a number (or a boolean for !(!x)), since for a list or a string they either produce
+//! a new value or throw.
+//!
+//! Nodes are never modified: a node with a simplified child is copied into the unit's arena
+//! with the new child, so the Resolver's results carry over.
+class Optimizer : public ExprVisitor, public StmtVisitor {
+private:
+	Arena& m_unit;
+	Expr_ptr m_expr = nullptr;	//result of the last expression visited
+	Stmt_ptr m_stmt = nullptr;	//result of the last statement visited
+private:
+	//! Evaluates an expression whose operands are literals, nullptr if that throws
+	Expr_ptr fold(const Expr& expr, std::size_t line);
+
+	static bool isLiteral(Expr_ptr expr);
+	static bool isNumber(Expr_ptr expr, double num);
+	//! Whether expr always evaluates to a number or a boolean (or throws)
+	static bool isNumeric(Expr_ptr expr);
+	static bool isBoolean(Expr_ptr expr);
+public:
+	Optimizer(Arena& unit);
+
+	Expr_ptr optimize(Expr_ptr expr);
+	Stmt_ptr optimize(Stmt_ptr stmt);
+	//! Optimizes in place, true if any statement changed
+	bool optimize(Stmts& stmts);
+
+	// Inherited via ExprVisitor
+	virtual void visit(const Binary&) override;
+	virtual void visit(const Unary&) override;
+	virtual void visit(const ParenGroup&) override;
+	virtual void visit(const Literal&) override;
+	virtual void visit(const Variable&) override;
+	virtual void visit(const Logical&) override;
+	virtual void visit(const Assign&) override;
+	virtual void visit(const Call&) override;
+	virtual void visit(const Lambda&) override;
+	virtual void visit(const ListExpr&) override;
+	virtual void visit(const Index&) override;
+	virtual void visit(const RangeExpr&) override;
+	virtual void visit(const IndexAssign&) override;
+	virtual void visit(const InExpr&) override;
+
+	// Inherited via StmtVisitor
+	virtual void visit(const Expression&) override;
+	virtual void visit(const Block&) override;
+	virtual void visit(const If&) override;
+	virtual void visit(const While&) override;
+	virtual void visit(const For&) override;
+	virtual void visit(const RangedFor&) override;
+	virtual void visit(const Func&) override;
+	virtual void visit(const Return&) override;
+	virtual void visit(const Break&) override;
+	virtual void visit(const Continue&) override;
+};
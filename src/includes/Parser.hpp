@@ -10,6 +10,7 @@
 #include "Expressions.hpp"
 #include "Token.hpp"
 #include "Statements.hpp"
+#include "Arena.hpp"
 
 class ParseError : std::exception {
 private:
@@ -26,30 +27,31 @@ public:
 
 class Parser {
 private:
-	std::vector<Token> m_tokens;
+	const std::vector<Token>& m_tokens;	//owned by the Lexer
+	Arena& m_arena;	//every node goes in here
 	std::size_t m_current;
 	bool m_allowExpr;
 	bool m_foundExpr;
 	std::size_t m_loopDepth;
 public:
 	Parser() = delete;
-	Parser(std::vector<Token>& tokens, bool parseRepl = false);
+	Parser(const std::vector<Token>& tokens, Arena& arena, bool parseRepl = false);
 	std::variant<Stmts, Expr_ptr> parse();
 private:
 //! Helpers
 
 	bool isAtEnd();
-	Token peek();
-	Token previous();
+	const Token& peek();
+	const Token& previous();
 	bool isNextType(TokenType type);
 	bool isNextNextType(TokenType type);
-	Token advance(); //! Consume the next token
+	const Token& advance(); //! Consume the next token
 	
 	//! Consume the next token if it matches any type of types
 	bool match(const std::list<TokenType>& types);
 	bool match(TokenType type);
 	
-	ParseError error(Token t, std::string_view msg);
+	ParseError error(const Token& t, std::string_view msg);
 
 	//! The next token is expected to be type. If it is not, we have 
 	//! an error.
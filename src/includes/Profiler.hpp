@@ -0,0 +1,70 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//! Samples the call stack of the running script (--profile).
+//!
+//! A background thread ticks every INTERVAL. The interpreter checks for pending ticks at
+//! its safe points (every statement in the tree walker, calls and backward jumps in the
+//! VM) and hands over its call stack, which is charged with all the ticks since the last
+//! sample. Time spent in a native function is charged to the next safe point after it.
+//!
+//! At exit the stacks are written in the folded format flamegraph tools take
+//! ("<script>:1;fib:3;fib:3 42"), and a table of the functions with the most self and
+//! total time is printed. A frame a tail call replaced is gone from the stack, the frame
+//! that took its place is marked instead ("<script>:1;loop[tail]:4 42").
+class Profiler {
+public:
+	struct Frame {
+		std::string_view m_name;	//empty for lambdas
+		std::size_t m_line;			//of the statement or instruction being executed
+		bool m_isTail = false;		//entered through a tail call, which took its caller's place
+	};
+private:
+	struct Times {
+		std::size_t m_self = 0;		//ticks as the innermost frame
+		std::size_t m_total = 0;	//ticks anywhere on the stack, counting recursion once
+	};
+
+	static constexpr std::chrono::microseconds INTERVAL{ 1000 };
+
+	std::atomic<std::uint32_t> m_pending{ 0 };	//ticks since the last sample
+	std::atomic<bool> m_running{ false };
+	std::thread m_ticker;
+
+	std::string m_output;	//folded stacks go here
+	std::unordered_map<std::string, std::size_t> m_stacks;	//folded stack to ticks
+	std::unordered_map<std::string, Times> m_functions;
+	std::size_t m_ticks = 0;
+	std::size_t m_tailCalls = 0;
+
+	Profiler() = default;
+public:
+	static Profiler& getInstance();
+	Profiler(const Profiler&) = delete;
+	void operator=(const Profiler&) = delete;
+	~Profiler();
+
+	void start(std::string output);
+	//! Stops ticking, writes the folded stacks and prints the top functions to out
+	void stop(std::ostream& out, std::size_t top = 20);
+
+	//! Checked at every safe point, so it has to stay this cheap
+	bool sampleDue() const {
+		return m_pending.load(std::memory_order_relaxed) != 0;
+	}
+	//! Outermost frame first
+	void sample(const std::vector<Frame>& stack);
+	//! Counts a call that reused its caller's frame, whether or not the profiler is running
+	void tailCall() {
+		m_tailCalls++;
+	}
+};
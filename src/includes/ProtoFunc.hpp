@@ -2,6 +2,7 @@
 #include "Callable.hpp"
 #include "Statements.hpp"
 #include "Environment.hpp"
+#include "Arena.hpp"
 
 
 class ProtoFunction : public Callable {
@@ -9,10 +10,17 @@ private:
 	std::string m_name;
 	std::vector<Token> m_params;
 	Stmts m_body;
+	std::size_t m_scopeSize;	//parameters take up the first slots
+	Upvalues m_upvalues;		//the variables it captured where it was defined
+	std::shared_ptr<Arena> m_unit;	//keeps m_body alive
 public:
-	ProtoFunction(Token name, const std::vector<Token>& params, Stmts body);
-	ProtoFunction(const std::string& name, const std::vector<Token>& params, Stmts body);
+	ProtoFunction(Token name, const std::vector<Token>& params, Stmts body, std::size_t scopeSize, Upvalues upvalues, std::shared_ptr<Arena> unit);
+	ProtoFunction(const std::string& name, const std::vector<Token>& params, Stmts body, std::size_t scopeSize, Upvalues upvalues, std::shared_ptr<Arena> unit);
 	virtual int arity() override;
 	virtual std::string info() override;
-	virtual Value call(const Values& args) override;
+	virtual Value call(Args args) override;
+	//! Runs the body with the arguments already in the interpreter's stack from frame on
+	Value callInPlace(std::size_t frame);
+	virtual void trace(Tracer& tracer) override;
+	virtual void clearRefs() override;
 };
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <map>
 #include <unordered_map>
 
 #include "Expressions.hpp"
@@ -9,9 +10,31 @@ private:
 	struct VarInfo {
 		std::size_t line = 0;
 		bool hasBeenRead = false;
+		std::size_t slot = 0;
 	};
 
 	std::vector<std::unordered_map<std::string, VarInfo>> m_scopes;
+
+	//! A scope without variables gets no environment at runtime, so the local references
+	//! resolved inside it that reach past it are one scope shallower. Every resolution
+	//! made while in a scope is kept with the index of the scope it found and the one it
+	//! is looked up from, until the outermost scope ends.
+	struct LocalRef {
+		Resolution* m_resolved;
+		std::size_t m_scope;
+		std::size_t m_from;
+	};
+	std::vector<LocalRef> m_localRefs;
+	std::vector<std::size_t> m_scopeRefs;	//where each scope's references start in m_localRefs
+
+	//! The functions being resolved, innermost last. A variable of an enclosing function
+	//! becomes an upvalue, captured when the function is created.
+	struct FunctionInfo {
+		std::size_t m_base;	//index of the parameter scope
+		Captures* m_captures;
+		std::map<std::pair<std::size_t, std::size_t>, std::size_t> m_indices;	//(scope, slot) to upvalue index
+	};
+	std::vector<FunctionInfo> m_functions;
 	
 	bool inFunction = false;
 	std::size_t rtrnWarnLine = 0;
@@ -21,11 +44,14 @@ private:
 
 private:
 	void beginScope();
-	void endScope();
+	std::size_t endScope();	//returns the number of slots the scope needs, 0 if it's elided
 
 	void define(Token name);
 	
-	void resolveLocal(const Expr& expr, Token name, bool hasBeenRead = false);
+	void resolveLocal(Resolution& resolved, Token name, bool hasBeenRead = false);
+	std::size_t functionLevel(std::size_t scope);	//how many functions enclose the scope, 0 for the script's
+	std::size_t addUpvalue(std::size_t level, std::size_t scope, std::size_t slot);	//index in that function's upvalues
+	void beginFunction(Captures& captures);
 	void resolveFunc(const Func& f);
 	void resolveFunc(const Lambda& f);
 
@@ -1,11 +0,0 @@
-#pragma once
-#include "Expressions.hpp"
-
-class ReturnThrow {
-public:
-	Value m_val;
-public:
-	ReturnThrow(Value val) : m_val(val) {
-
-	}
-};
\ No newline at end of file
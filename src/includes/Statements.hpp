@@ -1,6 +1,8 @@
 #pragma once
 #include "Expressions.hpp"
 
+class Arena;
+
 class Expression;
 class Block;
 class If;
@@ -27,11 +29,13 @@ public:
 };
 
 class Stmt {
+public:
+	mutable std::size_t m_line = 0;	//where the statement starts, set by the Parser
 public:
 	virtual void accept(StmtVisitor* visitor) const = 0;
 };
 
-using Stmt_ptr = std::shared_ptr<Stmt>;
+using Stmt_ptr = const Stmt*;
 using Stmts = std::vector<Stmt_ptr>;
 
 class Expression : public Stmt {
@@ -45,6 +49,7 @@ public:
 class Block : public Stmt {
 public:
 	Stmts m_stmts;
+	mutable std::size_t m_scopeSize = 0;	//number of local slots, set by the Resolver
 public:
 	Block(const Stmts& stmts);
 	virtual void accept(StmtVisitor* visitor) const override;
@@ -75,6 +80,7 @@ public:
 	Expr_ptr m_condition;
 	Expr_ptr m_increment;
 	Stmt_ptr m_body;
+	mutable std::size_t m_scopeSize = 0;
 public:
 	For(Expr_ptr init, Expr_ptr cond, Expr_ptr increment, Stmt_ptr body);
 	virtual void accept(StmtVisitor* visitor) const override;
@@ -84,6 +90,7 @@ class RangedFor : public Stmt {
 public:
 	Expr_ptr m_inexpr;
 	Stmt_ptr m_body;
+	mutable std::size_t m_scopeSize = 0;
 public:
 	RangedFor(Expr_ptr inexpr, Stmt_ptr body);
 	virtual void accept(StmtVisitor* visitor) const override;
@@ -94,8 +101,12 @@ public:
 	Token m_name;
 	std::vector<Token> m_params;
 	Stmts m_body;
+	mutable std::size_t m_scopeSize = 0;
+	mutable Captures m_captures;	//set by the Resolver
+	mutable Resolution m_resolved;
+	Arena* m_unit;	//owns the body
 public:
-	Func(Token name, const std::vector<Token>& params, const Stmts& body);
+	Func(Token name, const std::vector<Token>& params, const Stmts& body, Arena* unit);
 	virtual void accept(StmtVisitor* visitor) const override;
 };
 
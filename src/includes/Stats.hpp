@@ -0,0 +1,98 @@
+#pragma once
+
+//! Execution counters for deciding which fast paths are worth it, compiled in with
+//! -DPROTO_STATS and reported to stderr at exit. Without the define every macro below
+//! expands to nothing.
+//!
+//! Counts and times how often each tree walker visit and VM instruction runs, and counts
+//! the objects created by type, Value copies and runtime errors. Times are self times (a
+//! visit's nested visits are subtracted), so they add up to the run time. Reading the clock
+//! around every visit and instruction slows execution down a lot, so compare the times
+//! relative to each other rather than to an uninstrumented build.
+#ifdef PROTO_STATS
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+class Stats {
+public:
+	struct Entry {
+		const char* m_name = nullptr;
+		std::size_t m_count = 0;
+		std::chrono::nanoseconds m_self{ 0 };
+		bool m_linked = false;		//visits add themselves to the list on first use
+		Entry* m_next = nullptr;
+	};
+
+	//! Times an Entry for as long as it's in scope
+	class Timer {
+	private:
+		Entry& m_entry;
+		Timer* m_parent;
+		std::chrono::nanoseconds m_nested{ 0 };
+		std::chrono::steady_clock::time_point m_start;
+	public:
+		Timer(Entry& entry);
+		~Timer();
+		Timer(const Timer&) = delete;
+		void operator=(const Timer&) = delete;
+	};
+
+	enum class Event : std::uint8_t {
+		STRINGS,		//objects created, in the order of Obj::Type
+		CALLABLES,
+		LISTS,
+		ENVIRONMENTS,
+		UPVALUES,
+		VALUE_COPIES,
+		RUNTIME_ERRORS,
+		COUNT
+	};
+private:
+	//! Only plain data, so it's still usable while other singletons are destroyed
+	Entry* m_visits = nullptr;
+	Entry m_ops[256];
+	std::size_t m_events[static_cast<std::size_t>(Event::COUNT)] = {};
+	Timer* m_current = nullptr;
+
+	Stats() = default;
+public:
+	static Stats& getInstance();
+	Stats(const Stats&) = delete;
+	void operator=(const Stats&) = delete;
+
+	Entry& visit(Entry& entry) {
+		if (!entry.m_linked) {
+			entry.m_linked = true;
+			entry.m_next = m_visits;
+			m_visits = &entry;
+		}
+		return entry;
+	}
+	Entry& op(std::uint8_t code, const char* name) {
+		m_ops[code].m_name = name;
+		return m_ops[code];
+	}
+	void count(Event event) {
+		m_events[static_cast<std::size_t>(event)]++;
+	}
+
+	void print(std::ostream& out) const;
+};
+
+#define PROTO_STATS_VISIT(name) \
+	static Stats::Entry protoStatsEntry{ name }; \
+	Stats::Timer protoStatsTimer{ Stats::getInstance().visit(protoStatsEntry) }
+#define PROTO_STATS_OP(op) \
+	Stats::Timer protoStatsTimer{ Stats::getInstance().op(static_cast<std::uint8_t>(op), opName(op)) }
+#define PROTO_STATS_COUNT(event) Stats::getInstance().count(event)
+
+#else
+
+#define PROTO_STATS_VISIT(name)
+#define PROTO_STATS_OP(op)
+#define PROTO_STATS_COUNT(event)
+
+#endif
@@ -91,24 +91,40 @@ const std::unordered_map<TokenType, std::string_view> typeStr = {
     {TokenType::WHILE, "WHILE"}
 };
 
-const std::unordered_map<std::string, TokenType> keywords = {
-    {"and", TokenType::AND},
-    {"class", TokenType::CLASS},
-    {"else", TokenType::ELSE},
-    {"if", TokenType::IF},
-    {"in", TokenType::IN},
-    {"false", TokenType::FALSE},
-    {"true", TokenType::TRUE},
-    {"nix", TokenType::NIX},
-    {"fn", TokenType::FUNCTION},
-    {"for", TokenType::FOR},
-    {"or", TokenType::OR},
-    {"this", TokenType::THIS},
-    {"while", TokenType::WHILE},
-    {"return", TokenType::RETURN},
-    {"break", TokenType::BREAK},
-    {"continue", TokenType::CONTINUE}
-};
+//! A switch on the first character leaves at most three keywords to compare with, and
+//! string_view compares lengths first. Anything else is an identifier.
+constexpr TokenType keywordType(std::string_view str) {
+    auto is = [str](std::string_view keyword) { return str == keyword; };
+    switch (str[0]) {
+    case 'a': if (is("and")) return TokenType::AND; break;
+    case 'b': if (is("break")) return TokenType::BREAK; break;
+    case 'c':
+        if (is("class")) return TokenType::CLASS;
+        if (is("continue")) return TokenType::CONTINUE;
+        break;
+    case 'e': if (is("else")) return TokenType::ELSE; break;
+    case 'f':
+        if (is("fn")) return TokenType::FUNCTION;
+        if (is("for")) return TokenType::FOR;
+        if (is("false")) return TokenType::FALSE;
+        break;
+    case 'i':
+        if (is("if")) return TokenType::IF;
+        if (is("in")) return TokenType::IN;
+        break;
+    case 'n': if (is("nix")) return TokenType::NIX; break;
+    case 'o': if (is("or")) return TokenType::OR; break;
+    case 'r': if (is("return")) return TokenType::RETURN; break;
+    case 't':
+        if (is("true")) return TokenType::TRUE;
+        if (is("this")) return TokenType::THIS;
+        break;
+    case 'w': if (is("while")) return TokenType::WHILE; break;
+    }
+    return TokenType::IDENTIFIER;
+}
+
+static_assert(keywordType("continue") == TokenType::CONTINUE && keywordType("fnord") == TokenType::IDENTIFIER);
 
 enum class LiteralType {
     NONE, //Not a literal
@@ -130,16 +146,17 @@ const std::unordered_map<LiteralType, std::string_view> ltypeStr = {
 
 class Token {
 private:
-    TokenType m_type;
-    std::string m_lexeme;
+    std::string_view m_lexeme;  //into the unit's source, an interned literal or a static string
     std::size_t m_line;
+    TokenType m_type;
     LiteralType m_ltype; //Literal Type
 public:
     Token() = delete;
-    Token(TokenType type, std::string lexeme, std::size_t line, LiteralType ltype) 
-        : m_type(type), m_lexeme(lexeme), m_line(line), m_ltype(ltype) {}
+    Token(TokenType type, std::string_view lexeme, std::size_t line, LiteralType ltype) 
+        : m_lexeme(lexeme), m_line(line), m_type(type), m_ltype(ltype) {}
     friend std::ostream& operator<<(std::ostream& os, const Token& t);
     std::string str() const;
+    std::string_view lexeme() const;
     std::string_view typeAsStr() const;
     std::string_view ltypeAsStr() const;
     TokenType getType() const;
@@ -0,0 +1,61 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "Expressions.hpp"
+#include "Environment.hpp"
+#include "CompiledFunc.hpp"
+
+class RuntimeError;
+
+//! A stack based virtual machine executing the bytecode produced by the Compiler.
+class VM {
+private:
+	struct Frame {
+		CompiledFunction* m_fn;	//kept alive by the callee slot at m_base
+		const std::uint8_t* m_ip;
+		std::size_t m_base;		//stack index of the callee, followed by the arguments and the rest of the outermost scope
+		Env_ptr m_callerEnv;	//environment to restore on return
+		bool m_isTail = false;	//entered through a tail call, see replaceFrame
+	};
+
+	Values m_stack;
+	std::vector<Frame> m_frames;
+	Env_ptr m_env;		//the current environment
+	Env_ptr m_global;	//the global environment
+
+private:
+	Value pop();
+	Value& peek(std::size_t distance = 0);
+
+	void pushFrame(CompiledFunction& fn, std::size_t argc);
+	//! A tail call reuses the calling frame, the callee and its arguments move down to its base
+	void replaceFrame(CompiledFunction& fn, std::size_t argc);
+	Callable* checkCallee(std::size_t argc);	//the callee below argc arguments, if it can take them
+	void callValue(std::size_t argc, bool isTail);
+	void callGlobal(std::size_t argc, GlobalCache& cache, bool isTail);
+	void invoke(Callable* fn, CompiledFunction* compiled, std::size_t argc, bool isTail);
+	Token currentToken() const;		//error reporting token for the instruction being executed
+	void sample();	//hands the frames to the Profiler
+	RuntimeError error(const std::string& err) const;
+	RuntimeError undefined(const Token& name) const;	//a chunk's name has its first line, the error gets the current one
+
+	//! Unwinds to the innermost Handler around the failing instruction, popping the frames
+	//! above it. False if there's none above exitDepth.
+	bool recover(std::size_t exitDepth);
+	Value dispatch(std::size_t exitDepth);
+	//! Runs until the frame count drops back to exitDepth and returns the last returned value
+	Value run(std::size_t exitDepth);
+	Value execute(obj_ptr<CompiledFunction> script);
+
+	VM();
+public:
+	static VM& getInstance();
+	VM(const VM&) = delete;
+	void operator=(const VM&) = delete;
+
+	Value call(CompiledFunction& fn, Args args);
+
+	void interpret(obj_ptr<CompiledFunction> script);
+	std::string interpret(obj_ptr<CompiledFunction> script, const Expr_ptr& expr);
+};
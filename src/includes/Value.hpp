@@ -0,0 +1,289 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Stats.hpp"
+
+class Obj;
+
+//! Visits the objects another object holds references to, see Obj::trace
+class Tracer {
+public:
+	virtual void visit(Obj* obj) = 0;
+	//! Called before tracing the contents of a buffer shared by owners objects (its use_count).
+	//! Returns whether the caller should trace the contents now, by default on every owner.
+	virtual bool visitShared(const void*, long) { return true; }
+};
+
+//! Base of every heap object a Value can refer to. Objects are reference counted
+//! intrusively so that a Value stays a single word. Everything but strings can hold
+//! references and is also tracked by the GC, which frees the cycles refcounting can't.
+class Obj {
+public:
+	enum class Type : std::uint8_t {
+		STR,
+		CALLABLE,
+		LIST,
+		ENV,
+		UPVALUE
+	};
+	Type m_objType;
+	std::uint32_t m_refs = 0;
+
+	//! GC bookkeeping
+	bool m_tracked = false;
+	bool m_old = false;		//survived a collection
+	bool m_marked = false;
+	std::int64_t m_gcRefs = 0;
+	Obj* m_gcPrev = nullptr;
+	Obj* m_gcNext = nullptr;
+public:
+	Obj(Type type);
+	//! A copy is a new object, so it starts without references
+	Obj(const Obj& other);
+	Obj& operator=(const Obj&) { return *this; }
+	virtual ~Obj();
+
+	//! Reports every object this one holds a reference to
+	virtual void trace(Tracer&) {}
+	//! Drops those references. Only called on unreachable objects, to break their cycles.
+	virtual void clearRefs() {}
+
+	void retain() {
+		m_refs++;
+	}
+	void release() {
+		if (--m_refs == 0) delete this;
+	}
+};
+
+template <typename T>
+class obj_ptr {
+private:
+	T* m_ptr = nullptr;
+public:
+	obj_ptr() = default;
+	obj_ptr(std::nullptr_t) {}
+	explicit obj_ptr(T* ptr) : m_ptr(ptr) {
+		if (m_ptr) m_ptr->retain();
+	}
+	template <typename U>
+	obj_ptr(const obj_ptr<U>& other) : obj_ptr(other.get()) {}
+	obj_ptr(const obj_ptr& other) : obj_ptr(other.m_ptr) {}
+	obj_ptr(obj_ptr&& other) noexcept : m_ptr(other.m_ptr) {
+		other.m_ptr = nullptr;
+	}
+	obj_ptr& operator=(obj_ptr other) noexcept {
+		std::swap(m_ptr, other.m_ptr);
+		return *this;
+	}
+	~obj_ptr() {
+		if (m_ptr) m_ptr->release();
+	}
+
+	T* get() const { return m_ptr; }
+	T* operator->() const { return m_ptr; }
+	T& operator*() const { return *m_ptr; }
+	explicit operator bool() const { return m_ptr != nullptr; }
+	bool operator==(const obj_ptr& other) const { return m_ptr == other.m_ptr; }
+	bool operator!=(const obj_ptr& other) const { return m_ptr != other.m_ptr; }
+};
+
+template <typename T, typename... Args>
+obj_ptr<T> make_obj(Args&&... args) {
+	return obj_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+//! Strings are immutable, so every Value referring to one can share it
+class str_t : public Obj {
+public:
+	const std::string m_str;
+public:
+	str_t(std::string str) : Obj(Type::STR), m_str(std::move(str)) {}
+};
+
+//! The order matches list_t::Type
+enum class ValueType : std::size_t {
+	STR = 0,
+	NUM,
+	NIX,
+	BOOL,
+	CALLABLE,
+	LIST
+};
+
+//! A NaN-boxed value. Numbers are stored as plain doubles, everything else lives
+//! in the payload of a quiet NaN: nix and the booleans as small tags, objects as
+//! a pointer with the sign bit set.
+//!
+//! Whole numbers that fit in 32 bits (except -0) are always stored as an integer in the
+//! payload instead, so they compare and index without floating point, and a number has
+//! exactly one representation. Scripts still see a single number type: asNum works for
+//! both, and integer arithmetic that overflows just gives a double.
+class Value {
+private:
+	static constexpr std::uint64_t SIGN_BIT = 0x8000000000000000;
+	static constexpr std::uint64_t QNAN = 0x7ffc000000000000;
+	static constexpr std::uint64_t CANONICAL_NAN = 0x7ff8000000000000;
+	static constexpr std::uint64_t TAG_NIX = 1;
+	static constexpr std::uint64_t TAG_FALSE = 2;
+	static constexpr std::uint64_t TAG_TRUE = 3;
+	static constexpr std::uint64_t TAG_UNDEFINED = 4;
+	static constexpr std::uint64_t INT_TAG = QNAN | 0x0001000000000000;	//the low 32 bits hold the integer
+	static constexpr std::uint64_t INT_MASK = 0xffffffff00000000;
+
+	std::uint64_t m_bits;
+private:
+	bool isObj() const {
+		return (m_bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+	}
+	bool isObj(Obj::Type type) const {
+		return isObj() && asObj()->m_objType == type;
+	}
+	Obj* asObj() const {
+		return reinterpret_cast<Obj*>(static_cast<std::uintptr_t>(m_bits & ~(SIGN_BIT | QNAN)));
+	}
+	void retain() const {
+		if (isObj()) asObj()->retain();
+	}
+	void release() const {
+		if (isObj()) asObj()->release();
+	}
+public:
+	Value() : m_bits(QNAN | TAG_NIX) {}
+	Value(std::nullptr_t) : m_bits(QNAN | TAG_NIX) {}
+	Value(bool b) : m_bits(QNAN | (b ? TAG_TRUE : TAG_FALSE)) {}
+	Value(double num) {
+		if (num >= INT32_MIN && num <= INT32_MAX && num == static_cast<std::int32_t>(num) && (num != 0 || !std::signbit(num))) {
+			m_bits = INT_TAG | static_cast<std::uint32_t>(static_cast<std::int32_t>(num));
+		}
+		//! Keep NaNs produced by arithmetic out of the tagged space
+		else if (num != num) m_bits = CANONICAL_NAN;
+		else std::memcpy(&m_bits, &num, sizeof(num));
+	}
+	//! The result of integer arithmetic, a double if it doesn't fit
+	static Value integer(std::int64_t num) {
+		if (num < INT32_MIN || num > INT32_MAX) return static_cast<double>(num);
+		Value val;
+		val.m_bits = INT_TAG | static_cast<std::uint32_t>(static_cast<std::int32_t>(num));
+		return val;
+	}
+	//! Keeps the -0 a product of doubles would give
+	static Value product(std::int64_t left, std::int64_t right) {
+		if (left * right == 0 && (left < 0 || right < 0)) return -0.0;
+		return integer(left * right);
+	}
+	Value(std::string str) : Value(static_cast<Obj*>(new str_t(std::move(str)))) {}
+	Value(const char* str) : Value(std::string(str)) {}
+	explicit Value(Obj* obj) : m_bits(SIGN_BIT | QNAN | static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(obj))) {
+		retain();
+	}
+	template <typename T>
+	Value(const obj_ptr<T>& obj) : Value(static_cast<Obj*>(obj.get())) {}
+
+	Value(const Value& other) : m_bits(other.m_bits) {
+		PROTO_STATS_COUNT(Stats::Event::VALUE_COPIES);
+		retain();
+	}
+	Value(Value&& other) noexcept : m_bits(other.m_bits) {
+		other.m_bits = QNAN | TAG_NIX;
+	}
+	Value& operator=(const Value& other) {
+		PROTO_STATS_COUNT(Stats::Event::VALUE_COPIES);
+		other.retain();
+		release();
+		m_bits = other.m_bits;
+		return *this;
+	}
+	Value& operator=(Value&& other) noexcept {
+		std::swap(m_bits, other.m_bits);
+		return *this;
+	}
+	~Value() {
+		release();
+	}
+
+	//! Marks a local slot that hasn't been assigned yet. Never visible to scripts.
+	static Value undefined() {
+		Value val;
+		val.m_bits = QNAN | TAG_UNDEFINED;
+		return val;
+	}
+
+	bool isNum() const { return (m_bits & QNAN) != QNAN || isInt(); }
+	bool isInt() const { return (m_bits & INT_MASK) == INT_TAG; }
+	bool isNix() const { return m_bits == (QNAN | TAG_NIX); }
+	bool isBool() const { return (m_bits | 1) == (QNAN | TAG_TRUE); }
+	bool isUndefined() const { return m_bits == (QNAN | TAG_UNDEFINED); }
+	bool isStr() const { return isObj(Obj::Type::STR); }
+	bool isCallable() const { return isObj(Obj::Type::CALLABLE); }
+	bool isList() const { return isObj(Obj::Type::LIST); }
+	bool isUpvalue() const { return isObj(Obj::Type::UPVALUE); }	//only ever held by an environment slot
+
+	double asNum() const {
+		if (isInt()) return asInt();
+		double num;
+		std::memcpy(&num, &m_bits, sizeof(num));
+		return num;
+	}
+	std::int32_t asInt() const { return static_cast<std::int32_t>(static_cast<std::uint32_t>(m_bits)); }
+	bool asBool() const { return m_bits == (QNAN | TAG_TRUE); }
+	const std::string& asStr() const { return static_cast<str_t*>(asObj())->m_str; }
+
+	//! For lists and callables; the caller has to make sure the value is of that type
+	template <typename T>
+	T* as() const { return static_cast<T*>(asObj()); }
+	template <typename T>
+	obj_ptr<T> asRef() const { return obj_ptr<T>(as<T>()); }
+
+	//! The object this value refers to, if any
+	Obj* obj() const { return isObj() ? asObj() : nullptr; }
+
+	ValueType type() const {
+		if (isNum()) return ValueType::NUM;
+		if (isNix()) return ValueType::NIX;
+		if (isBool()) return ValueType::BOOL;
+		switch (asObj()->m_objType) {
+		case Obj::Type::STR: return ValueType::STR;
+		case Obj::Type::CALLABLE: return ValueType::CALLABLE;
+		default: return ValueType::LIST;
+		}
+	}
+
+	//! Exact equality: strings by content, lists and callables by identity
+	bool operator==(const Value& other) const {
+		if (isNum() && other.isNum()) return asNum() == other.asNum();
+		if (isStr() && other.isStr()) return asStr() == other.asStr();
+		return m_bits == other.m_bits;
+	}
+	bool operator!=(const Value& other) const {
+		return !(*this == other);
+	}
+};
+
+using Values = std::vector<Value>;
+
+//! The arguments of a call, viewed where the caller keeps them (the VM passes its stack).
+//! Only valid until the callee runs script code, which may grow that stack.
+class Args {
+private:
+	const Value* m_begin;
+	const Value* m_end;
+public:
+	Args(const Value* begin, const Value* end) : m_begin(begin), m_end(end) {}
+	Args(const Values& vals) : m_begin(vals.data()), m_end(vals.data() + vals.size()) {}
+
+	std::size_t size() const { return static_cast<std::size_t>(m_end - m_begin); }
+	const Value* begin() const { return m_begin; }
+	const Value* end() const { return m_end; }
+	const Value& operator[](std::size_t i) const { return m_begin[i]; }
+	const Value& at(std::size_t i) const {
+		if (i >= size()) throw std::out_of_range("Argument index out of range.");
+		return m_begin[i];
+	}
+};
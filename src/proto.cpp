@@ -1,12 +1,16 @@
 #include "proto.hpp"
 
 #include <filesystem>
-#include <fstream>
 
 #include "includes/Lexer.hpp"
 #include "includes/Parser.hpp"
 #include "includes/Interpreter.hpp"
 #include "includes/Resolver.hpp"
+#include "includes/Optimizer.hpp"
+#include "includes/Compiler.hpp"
+#include "includes/VM.hpp"
+#include "includes/BytecodeCache.hpp"
+#include "includes/MappedFile.hpp"
 
 #include "dep/rang.hpp"
 using namespace rang;
@@ -17,10 +21,17 @@ Proto& Proto::getInstance() {
 }
 
 void Proto::run(std::string src, bool allowExpr) {
-    auto lexer = Lexer(std::move(src));
-    auto& tokens = lexer.scanTokens(*this);
-    auto parser = Parser(tokens, allowExpr);
-    auto parsedOut = parser.parse();
+    run(std::make_shared<Arena>(std::move(src)), allowExpr);
+}
+
+//! The unit (source and AST) lives as long as this, or a function defined in it, does.
+//! The tokens are only needed by the parser, so they're freed before anything runs.
+void Proto::run(std::shared_ptr<Arena> unit, bool allowExpr) {
+    auto parsedOut = [&] {
+        auto lexer = Lexer(*unit);
+        auto& tokens = lexer.scanTokens(*this);
+        return Parser(tokens, *unit, allowExpr).parse();
+    }();
 
     if (hadError()) return; //stop if there was an error
 
@@ -31,12 +42,46 @@ void Proto::run(std::string src, bool allowExpr) {
             res.resolve(stmt);
         }
         if (hadError()) return;
-        Interpreter::getInstance().interpret(std::get<Stmts>(parsedOut));
+        Optimizer(*unit).optimize(std::get<Stmts>(parsedOut));
+
+        if (m_treeWalk) {
+            Interpreter::getInstance().interpret(std::get<Stmts>(parsedOut));
+            return;
+        }
+        Compiler compiler(unit);
+        auto script = compiler.compileScript(std::get<Stmts>(parsedOut));
+        if (hadError()) return;
+        if (!script) {
+            //! A file runs on its own, but the repl's earlier lines left their globals in the VM
+            if (allowExpr) error(compiler.limitLine(), compiler.limit());
+            else Interpreter::getInstance().interpret(std::get<Stmts>(parsedOut));
+            return;
+        }
+        if (m_cacheScript) {
+            BytecodeCache::getInstance().store(unit->source(), *script, m_warnings);
+        }
+        VM::getInstance().interpret(script);
     }
     else {
-        res.resolve(std::get<Expr_ptr>(parsedOut));
+        auto& expr = std::get<Expr_ptr>(parsedOut);
+        res.resolve(expr);
         if (hadError()) return;
-        auto result = Interpreter::getInstance().interpret(std::get<Expr_ptr>(parsedOut));
+        expr = Optimizer(*unit).optimize(expr);
+
+        std::string result;
+        if (m_treeWalk) {
+            result = Interpreter::getInstance().interpret(expr);
+        }
+        else {
+            Compiler compiler(unit);
+            auto script = compiler.compileScript(expr);
+            if (hadError()) return;
+            if (!script) {
+                error(compiler.limitLine(), compiler.limit());
+                return;
+            }
+            result = VM::getInstance().interpret(script, expr);
+        }
         if (result != "") {
             std::cout << result << '\n';
         }
@@ -52,15 +97,33 @@ void Proto::runFile(std::string_view path) {
         std::exit(64);
     }
     else {
-        std::string src;
-        std::ifstream file{ path.data() };
+        //! Lexed in place, the mapping goes away with the unit
+        auto file = std::make_unique<MappedFile>(loc.string());
+        if (!file->isOpen()) {
+            std::cerr << fgB::red << "[ERR] Could not read the file." << fg::reset;
+            std::exit(66);
+        }
 
-        src.assign((std::istreambuf_iterator<char>(file)), (std::istreambuf_iterator<char>()));
-        run(src);
+        auto& cache = BytecodeCache::getInstance();
+        m_cacheScript = !m_treeWalk && cache.isEnabled();
+        BytecodeCache::Warnings warnings;
+        if (auto script = m_cacheScript ? cache.load(file->view(), warnings) : nullptr) {
+            file.reset();
+            for (auto& [line, warning] : warnings) {
+                warn(line, warning);
+            }
+            VM::getInstance().interpret(script);
+            return;
+        }
+        run(std::make_shared<Arena>(std::move(file)), false);
         if (hadError()) std::exit(65);
     }
 }
 
+void Proto::setTreeWalk(bool val) {
+    m_treeWalk = val;
+}
+
 void Proto::setErr(bool val) {
     m_hitError = val;
 }
@@ -84,8 +147,10 @@ void Proto::error(std::size_t line, std::string_view msg, std::string snippet) {
 
 void Proto::runtimeError(const RuntimeError& error) {
     std::cerr << fgB::red << "[RUNTIME ERROR | Line " << error.getToken().getLine() << "]: " << fg::reset << style::dim << error.what() << style::reset << '\n';
+    setRuntimeError(true);
 }
 
 void Proto::warn(std::size_t line, const std::string& warning) {
+    if (m_cacheScript) m_warnings.emplace_back(line, warning);
     std::cerr << fgB::yellow << "[Warning | Line " << line << "]: " << fg::reset << style::dim << warning << style::reset << '\n';
 }
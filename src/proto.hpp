@@ -1,16 +1,25 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 #include "includes/Expressions.hpp"
 
 class RuntimeError;
+class Arena;
 
 class Proto {
 private:
     bool m_hitError = false;
     bool m_hitRuntimeError = false;
+    bool m_treeWalk = false;    //use the tree walk interpreter instead of the bytecode VM
+    bool m_cacheScript = false; //store the compiled script in the BytecodeCache
+    std::vector<std::pair<std::size_t, std::string>> m_warnings;    //kept while m_cacheScript
     Proto() = default;
+
+    void run(std::shared_ptr<Arena> unit, bool allowExpr);
 public:
     static Proto& getInstance();
     Proto(const Proto&) = delete;
@@ -18,6 +27,7 @@ public:
     void run(std::string src, bool allowExpr = false);
     void runFile(std::string_view path);
 
+    void setTreeWalk(bool val);
     void setErr(bool val);
     void setRuntimeError(bool val);
     bool hadError() const;
@@ -5,6 +5,10 @@
 #define EXIT_UNEXPECTED_ARGS 2
 
 #include "proto.hpp"
+#include "includes/GC.hpp"
+#include "includes/BytecodeCache.hpp"
+#include "includes/Profiler.hpp"
+#include "includes/Stats.hpp"
 
 #include "dep/rang.hpp"
 
@@ -56,16 +60,45 @@ void repl(Proto& proto) {
 }
 
 int main(int argc, char **argv) {
-    if (argc > 2) {
-        std::cout << fgB::blue << "Usage:" << fgB::green << " proto " << fg::reset << style::dim << "[source]" << style::reset;
-        std::exit(EXIT_UNEXPECTED_ARGS);
+    auto& proto = Proto::getInstance();
+    const char* source = nullptr;
+
+#ifdef PROTO_STATS
+    std::atexit([] { Stats::getInstance().print(std::cerr); });
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tree-walk") {
+            proto.setTreeWalk(true);
+        }
+        else if (arg == "--no-cache") {
+            BytecodeCache::getInstance().setEnabled(false);
+        }
+        else if (arg == "--gc-stats") {
+            //! atexit, since runFile exits on errors
+            std::atexit([] { GC::getInstance().printStats(std::cerr); });
+        }
+        else if (arg == "--profile" || (arg.rfind("--profile=", 0) == 0 && arg.size() > 10)) {
+            Profiler::getInstance().start(arg.size() > 10 ? arg.substr(10) : "proto.folded");
+            std::atexit([] { Profiler::getInstance().stop(std::cerr); });
+        }
+        else if (arg.rfind("--gc-threshold=", 0) == 0 && arg.size() > 15 && arg.find_first_not_of("0123456789", 15) == std::string::npos) {
+            GC::getInstance().setThreshold(std::stoul(arg.substr(15)));
+        }
+        else if (source == nullptr && arg.rfind("--", 0) != 0) {
+            source = argv[i];
+        }
+        else {
+            std::cout << fgB::blue << "Usage:" << fgB::green << " proto " << fg::reset << style::dim << "[--tree-walk] [--no-cache] [--gc-stats] [--gc-threshold=N] [--profile[=FILE]] [source]" << style::reset;
+            std::exit(EXIT_UNEXPECTED_ARGS);
+        }
     }
-    else if (argc == 2) {
-        auto& proto = Proto::getInstance();
-        proto.runFile(argv[1]);
+
+    if (source != nullptr) {
+        proto.runFile(source);
     }
     else {
-        auto& proto = Proto::getInstance();
         repl(proto);
     }
-}
\ No newline at end of file
+}